@@ -0,0 +1,406 @@
+// Microbenchmark for the grain rendering kernels. Renders the same set of grains
+// with the old one-sample-at-a-time loop, the scalar kernel and the vectorised
+// kernel, and reports the cost per output sample at several grain counts. Also finds
+// the grain count where handing grains to the worker pool starts to pay off.
+
+#include "GrainKernels.h"
+#include "GrainWorkerPool.h"
+#include "RingBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr int sampleRate = 48000;
+    constexpr int ringSize = 1 << 19; // About 11 s, the kernels need a power of two
+    constexpr int blockSize = GrainKernels::subBlockSize; // What the processor renders at a time
+    constexpr int numChannels = 2;
+    constexpr int numBlocks = 16000;
+
+    using Ring = RingBuffer<numChannels>;
+
+    // The processor's default grain window, built at the start of main()
+    GrainKernels::WindowTable window;
+
+    // The channel gains of a grain that isn't panned
+    const float centreGains[numChannels] = { 1.f, 1.f };
+
+    struct BenchGrain
+    {
+        int startSample;
+        int numSamples;
+        float playbackSpeed;
+        float readPosition;
+    };
+
+    struct Channels
+    {
+        std::vector<float> data[numChannels];
+
+        explicit Channels(int size)
+        {
+            for (auto& channel : data)
+                channel.assign(static_cast<size_t>(size), 0.f);
+        }
+
+        // Stands in for AudioBuffer::getSample/addSample, bounds check included
+        float getSample(int channel, int index) const { return data[channel].at(static_cast<size_t>(index)); }
+        void addSample(int channel, int index, float value) { data[channel].at(static_cast<size_t>(index)) += value; }
+    };
+
+    std::vector<BenchGrain> makeGrains(int numGrains, std::mt19937& rng)
+    {
+        std::uniform_int_distribution<int> start(0, ringSize - 1);
+        std::uniform_int_distribution<int> size(sampleRate / 100, sampleRate / 10);
+        std::uniform_real_distribution<float> speed(0.25f, 4.f);
+
+        std::vector<BenchGrain> grains;
+        for (int i = 0; i < numGrains; ++i)
+            grains.push_back({ start(rng), size(rng), speed(rng), 0.f });
+
+        return grains;
+    }
+
+    // Restarts grains that finished during the last block so the grain count stays constant
+    void restartFinishedGrains(std::vector<BenchGrain>& grains)
+    {
+        for (auto& grain : grains)
+            if (grain.readPosition + 1 >= grain.numSamples)
+                grain.readPosition = 0.f;
+    }
+
+    // The per-channel, per-sample loop that readOneGrain used before the kernels
+    void renderLegacy(const Ring& ring, Channels& out, std::vector<BenchGrain>& grains)
+    {
+        std::vector<float> endPositions(grains.size());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            for (size_t g = 0; g < grains.size(); ++g)
+            {
+                auto& grain = grains[g];
+                float readPosition = grain.readPosition;
+
+                for (int i = 0; i < blockSize && readPosition + 1 < grain.numSamples; ++i)
+                {
+                    int truncatedPos = static_cast<int>(readPosition);
+                    float fraction = readPosition - truncatedPos;
+                    int index1 = (grain.startSample + truncatedPos) % ringSize;
+                    int index2 = (index1 + 1) % ringSize;
+
+                    float sample1 = ring.getSample(channel, index1);
+                    float sample2 = ring.getSample(channel, index2);
+                    float interpolatedSample = sample1 * (1 - fraction) + sample2 * fraction;
+                    interpolatedSample *= GrainKernels::getWindowGain(window, readPosition, grain.numSamples);
+
+                    out.addSample(channel, i, interpolatedSample);
+                    readPosition += grain.playbackSpeed;
+                }
+
+                endPositions[g] = readPosition;
+            }
+        }
+
+        for (size_t g = 0; g < grains.size(); ++g)
+            grains[g].readPosition = endPositions[g];
+    }
+
+    template <typename RenderFunction>
+    void renderWithKernel(const Ring& ring, Channels& out, std::vector<BenchGrain>& grains,
+                          GrainKernels::GrainPositions& positions, RenderFunction&& render)
+    {
+        const float* source[numChannels] = { ring.getReadPointer(0), ring.getReadPointer(1) };
+
+        for (auto& grain : grains)
+        {
+            for (int i = 0; i < blockSize;)
+            {
+                int chunkSize = std::min(GrainKernels::maxChunkSize, blockSize - i);
+                int numSamples = GrainKernels::computePositions(positions, grain.startSample, grain.numSamples,
+                                                                grain.playbackSpeed, window, ringSize,
+                                                                grain.readPosition, chunkSize);
+
+                float* dest[numChannels] = { out.data[0].data() + i, out.data[1].data() + i };
+                render(source, dest, positions, numSamples);
+
+                if (numSamples < chunkSize)
+                    break;
+
+                i += numSamples;
+            }
+        }
+    }
+
+    template <typename BlockFunction>
+    double timeNsPerSample(std::vector<BenchGrain> grains, Channels& out, BlockFunction&& renderBlock)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            for (auto& channel : out.data)
+                std::fill(channel.begin(), channel.end(), 0.f);
+
+            renderBlock(grains);
+            restartFinishedGrains(grains);
+        }
+
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        return elapsed.count() / (static_cast<double>(numBlocks) * blockSize);
+    }
+
+    float maxDifference(const Channels& a, const Channels& b)
+    {
+        float difference = 0.f;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (size_t i = 0; i < a.data[channel].size(); ++i)
+                difference = std::max(difference, std::abs(a.data[channel][i] - b.data[channel][i]));
+
+        return difference;
+    }
+
+    struct WorkerContext
+    {
+        const float* const* source;
+        std::vector<BenchGrain>* grains;
+    };
+
+    // Renders one grain for the worker pool, the same way the processor's readOneGrain does
+    void renderGrainForWorker(void* context, int grainIndex, float* const* dest, int numDestChannels,
+                              int numSamples, GrainKernels::GrainPositions& positions)
+    {
+        auto& workerContext = *static_cast<WorkerContext*>(context);
+        auto& grain = (*workerContext.grains)[static_cast<size_t>(grainIndex)];
+
+        GrainKernels::renderGrain(workerContext.source, ringSize, dest, numDestChannels, centreGains,
+                                  grain.startSample, grain.numSamples, grain.playbackSpeed,
+                                  GrainKernels::RenderPath::linear, nullptr, window, grain.readPosition,
+                                  positions, numSamples);
+    }
+}
+
+//==============================================================================
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+
+    window.build(GrainKernels::WindowShape::trapezoid);
+
+    Ring ring;
+    ring.setSize(ringSize);
+
+    std::vector<float> noiseSamples(static_cast<size_t>(ringSize));
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (auto& sample : noiseSamples)
+            sample = noise(rng);
+
+        ring.write(channel, 0, noiseSamples.data(), ringSize);
+    }
+
+    GrainKernels::GrainPositions positions;
+    Channels legacyOut(blockSize), scalarOut(blockSize), vectorOut(blockSize);
+
+    std::printf("%8s %14s %14s %14s %10s %12s\n",
+                "grains", "legacy ns/smp", "scalar ns/smp", "vector ns/smp", "speedup", "max diff");
+
+    for (int numGrains : { 1, 8, 32, 128 })
+    {
+        auto grains = makeGrains(numGrains, rng);
+
+        auto legacy = timeNsPerSample(grains, legacyOut, [&] (std::vector<BenchGrain>& g)
+        {
+            renderLegacy(ring, legacyOut, g);
+        });
+
+        auto scalar = timeNsPerSample(grains, scalarOut, [&] (std::vector<BenchGrain>& g)
+        {
+            renderWithKernel(ring, scalarOut, g, positions, [] (const float* const* src, float* const* dst,
+                                                                const GrainKernels::GrainPositions& p, int n)
+            {
+                GrainKernels::renderLinearScalar(src, dst, numChannels, centreGains, p, 0, n);
+            });
+        });
+
+        auto vector = timeNsPerSample(grains, vectorOut, [&] (std::vector<BenchGrain>& g)
+        {
+            renderWithKernel(ring, vectorOut, g, positions, [] (const float* const* src, float* const* dst,
+                                                                const GrainKernels::GrainPositions& p, int n)
+            {
+                GrainKernels::renderLinear(src, dst, numChannels, centreGains, p, n);
+            });
+        });
+
+        // The scalar and vectorised kernels have to agree exactly
+        std::printf("%8d %14.3f %14.3f %14.3f %9.2fx %12g\n",
+                    numGrains, legacy, scalar, vector, legacy / vector, maxDifference(scalarOut, vectorOut));
+    }
+
+    // Compare the fast paths for unity and octave speeds against the general kernel
+    std::printf("\n%8s %8s %14s %14s %10s %12s\n",
+                "grains", "speed", "general ns/smp", "fast ns/smp", "speedup", "max diff");
+
+    for (float speed : { 1.f, 2.f, 0.5f })
+    {
+        constexpr int numGrains = 32;
+        auto grains = makeGrains(numGrains, rng);
+        for (auto& grain : grains)
+            grain.playbackSpeed = speed;
+
+        auto renderPaths = [&] (Channels& out, GrainKernels::RenderPath path)
+        {
+            return timeNsPerSample(grains, out, [&] (std::vector<BenchGrain>& g)
+            {
+                const float* source[numChannels] = { ring.getReadPointer(0), ring.getReadPointer(1) };
+                float* dest[numChannels] = { out.data[0].data(), out.data[1].data() };
+
+                for (auto& grain : g)
+                    GrainKernels::renderGrain(source, ringSize, dest, numChannels, centreGains,
+                                              grain.startSample, grain.numSamples, grain.playbackSpeed, path,
+                                              nullptr, window, grain.readPosition, positions, blockSize);
+            });
+        };
+
+        auto general = renderPaths(scalarOut, GrainKernels::RenderPath::linear);
+        auto fast = renderPaths(vectorOut, GrainKernels::getRenderPath(speed, GrainKernels::Interpolation::linear));
+
+        std::printf("%8d %8.2f %14.3f %14.3f %9.2fx %12g\n",
+                    numGrains, speed, general, fast, general / fast, maxDifference(scalarOut, vectorOut));
+    }
+
+    // Compare the cost of the interpolation kernels on grains at arbitrary speeds
+    GrainKernels::SincTables sincTables;
+    sincTables.build();
+
+    std::printf("\n%8s %14s %14s %14s\n", "grains", "linear ns/smp", "hermite ns/smp", "sinc ns/smp");
+
+    for (int numGrains : { 8, 32 })
+    {
+        auto grains = makeGrains(numGrains, rng);
+
+        auto renderInterpolated = [&] (GrainKernels::RenderPath path)
+        {
+            return timeNsPerSample(grains, scalarOut, [&] (std::vector<BenchGrain>& g)
+            {
+                const float* source[numChannels] = { ring.getReadPointer(0), ring.getReadPointer(1) };
+                float* dest[numChannels] = { scalarOut.data[0].data(), scalarOut.data[1].data() };
+
+                for (auto& grain : g)
+                    GrainKernels::renderGrain(source, ringSize, dest, numChannels, centreGains,
+                                              grain.startSample, grain.numSamples, grain.playbackSpeed, path,
+                                              sincTables.getTable(grain.playbackSpeed), window,
+                                              grain.readPosition, positions, blockSize);
+            });
+        };
+
+        std::printf("%8d %14.3f %14.3f %14.3f\n", numGrains,
+                    renderInterpolated(GrainKernels::RenderPath::linear),
+                    renderInterpolated(GrainKernels::RenderPath::hermite),
+                    renderInterpolated(GrainKernels::RenderPath::sinc));
+    }
+
+    // Panning is folded into the kernels' gains, so a panned grain should cost about the same as a centred one
+    GrainKernels::PanTable panTable;
+    panTable.build();
+
+    std::printf("\n%8s %14s %14s\n", "grains", "centred ns/smp", "panned ns/smp");
+
+    for (int numGrains : { 8, 32 })
+    {
+        auto grains = makeGrains(numGrains, rng);
+        std::vector<float> pans(static_cast<size_t>(numGrains));
+        for (auto& pan : pans)
+            pan = noise(rng);
+
+        auto renderPanned = [&] (bool panned)
+        {
+            return timeNsPerSample(grains, scalarOut, [&] (std::vector<BenchGrain>& g)
+            {
+                const float* source[numChannels] = { ring.getReadPointer(0), ring.getReadPointer(1) };
+                float* dest[numChannels] = { scalarOut.data[0].data(), scalarOut.data[1].data() };
+
+                for (size_t i = 0; i < g.size(); ++i)
+                {
+                    float channelGains[numChannels] = { 1.f, 1.f };
+                    if (panned)
+                        panTable.getGains(pans[i], channelGains);
+
+                    auto& grain = g[i];
+                    GrainKernels::renderGrain(source, ringSize, dest, numChannels, channelGains,
+                                              grain.startSample, grain.numSamples, grain.playbackSpeed,
+                                              GrainKernels::RenderPath::linear, nullptr, window,
+                                              grain.readPosition, positions, blockSize);
+                }
+            });
+        };
+
+        std::printf("%8d %14.3f %14.3f\n", numGrains, renderPanned(false), renderPanned(true));
+    }
+
+    // Find where the worker pool starts to beat rendering every grain on one thread
+    GrainWorkerPool workerPool;
+    workerPool.start(GrainWorkerPool::getDefaultNumWorkers(), numChannels, blockSize);
+
+    std::printf("\n%d workers (threshold in GrainWorkerPool: %d grains)\n",
+                workerPool.getNumWorkers(), GrainWorkerPool::minGrainsForWorkers);
+
+    // Without workers render() refuses every block, so there's nothing to time
+    if (workerPool.getNumWorkers() == 0)
+    {
+        std::printf("No spare cores for workers on this machine\n");
+        return 0;
+    }
+
+    std::printf("%8s %14s %14s %10s %12s\n", "grains", "serial ns/smp", "pooled ns/smp", "speedup", "max diff");
+
+    // The threshold is the smallest count from which the pool wins at every count tested
+    int threshold = -1;
+
+    for (int numGrains : { 4, 8, 16, 24, 32, 48, 64, 96, 128, 256, 512 })
+    {
+        auto grains = makeGrains(numGrains, rng);
+        const float* source[numChannels] = { ring.getReadPointer(0), ring.getReadPointer(1) };
+
+        auto serial = timeNsPerSample(grains, scalarOut, [&] (std::vector<BenchGrain>& g)
+        {
+            float* dest[numChannels] = { scalarOut.data[0].data(), scalarOut.data[1].data() };
+            WorkerContext context { source, &g };
+
+            for (int i = 0; i < numGrains; ++i)
+                renderGrainForWorker(&context, i, dest, numChannels, blockSize, positions);
+        });
+
+        auto pooled = timeNsPerSample(grains, vectorOut, [&] (std::vector<BenchGrain>& g)
+        {
+            float* dest[numChannels] = { vectorOut.data[0].data(), vectorOut.data[1].data() };
+            WorkerContext context { source, &g };
+
+            if (!workerPool.render(numGrains, dest, numChannels, blockSize, renderGrainForWorker, &context, positions))
+                for (int i = 0; i < numGrains; ++i)
+                    renderGrainForWorker(&context, i, dest, numChannels, blockSize, positions);
+        });
+
+        if (pooled >= serial)
+            threshold = -1;
+        else if (threshold < 0)
+            threshold = numGrains;
+
+        // Summing the partial buffers in a different order can change the last bit or so
+        std::printf("%8d %14.3f %14.3f %9.2fx %12g\n",
+                    numGrains, serial, pooled, serial / pooled, maxDifference(scalarOut, vectorOut));
+    }
+
+    if (threshold < 0)
+        std::printf("The worker pool didn't pay off at the highest grain count on this machine\n");
+    else
+        std::printf("The worker pool pays off from about %d grains\n", threshold);
+
+    return 0;
+}
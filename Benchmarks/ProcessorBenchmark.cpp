@@ -0,0 +1,133 @@
+// Headless benchmark for the whole processor. Creates GranularDelayAudioProcessor
+// directly, prepares it at several sample rates and block sizes, and pushes synthetic
+// audio through processBlock while sweeping the grain parameters one at a time. Prints
+// one CSV row per run so the results can be diffed or plotted across commits.
+//
+// Usage: ProcessorBenchmark [seconds of audio per run]
+
+#include "PluginProcessor.h"
+#include "TestUtilities.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    struct Sweep
+    {
+        const char* parameterID;
+        std::vector<float> values;
+    };
+
+    // Each sweep moves one parameter while the others stay at their defaults
+    const std::vector<Sweep> sweeps
+    {
+        { "grainSize",   { 10.f, 50.f, 100.f } },
+        { "frequency",   { 10.f, 50.f, 100.f } },
+        { "grainPitch",  { 0.5f, 1.f, 1.5f, 2.f, 4.f } },
+        { "detune",      { 0.f, 100.f, 500.f } },
+        { "feedback",    { 0.f, 0.5f, 0.9f } },
+        { "grainTiming", { 0.f, 2.f, 3.f } } // Free, Poisson, Target Overlap
+    };
+
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    const int blockSizes[] = { 64, 256, 1024 };
+
+    // Long enough for the grain cloud to fill up before timing starts
+    constexpr double warmUpSeconds = 1.0;
+
+    struct RunResult
+    {
+        double nsPerSample = 0;
+        double worstBlockMicroseconds = 0;
+        double meanBudgetPercent = 0;
+        double worstBudgetPercent = 0;
+        int peakNumGrains = 0;
+    };
+
+    RunResult run(GranularDelayAudioProcessor& processor, double sampleRate, int blockSize, double seconds)
+    {
+        processor.setRateAndBufferSize(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer(processor.getTotalNumOutputChannels(), blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(1234);
+        double phase = 0;
+
+        auto numWarmUpBlocks = static_cast<int>(warmUpSeconds * sampleRate / blockSize);
+        auto numBlocks = static_cast<int>(seconds * sampleRate / blockSize);
+        auto blockSeconds = blockSize / sampleRate;
+
+        for (int block = 0; block < numWarmUpBlocks; ++block)
+        {
+            TestUtilities::fillWithTestSignal(buffer, sampleRate, phase, random);
+            processor.processBlock(buffer, midi);
+        }
+
+        RunResult result;
+        double totalSeconds = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            // The test signal is made outside the timed section
+            TestUtilities::fillWithTestSignal(buffer, sampleRate, phase, random);
+
+            auto start = std::chrono::steady_clock::now();
+            processor.processBlock(buffer, midi);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            totalSeconds += elapsed.count();
+            result.worstBlockMicroseconds = juce::jmax(result.worstBlockMicroseconds, elapsed.count() * 1.0e6);
+            result.peakNumGrains = juce::jmax(result.peakNumGrains, processor.getNumLiveGrains());
+        }
+
+        processor.releaseResources();
+
+        result.nsPerSample = totalSeconds * 1.0e9 / (static_cast<double>(numBlocks) * blockSize);
+        result.meanBudgetPercent = 100.0 * totalSeconds / (numBlocks * blockSeconds);
+        result.worstBudgetPercent = 100.0 * result.worstBlockMicroseconds * 1.0e-6 / blockSeconds;
+        return result;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The parameter state uses timers and async updates, which need the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    double seconds = argc > 1 ? juce::jmax(0.1, std::atof(argv[1])) : 4.0;
+
+    GranularDelayAudioProcessor processor;
+
+    std::printf("sampleRate,blockSize,parameter,value,nsPerSample,worstBlockUs,meanBudgetPercent,"
+                "worstBudgetPercent,peakGrains\n");
+
+    for (auto sampleRate : sampleRates)
+    {
+        for (auto blockSize : blockSizes)
+        {
+            for (auto& sweep : sweeps)
+            {
+                for (auto value : sweep.values)
+                {
+                    TestUtilities::resetParameters(processor);
+                    TestUtilities::setParameter(processor.apvts, sweep.parameterID, value);
+
+                    auto result = run(processor, sampleRate, blockSize, seconds);
+
+                    std::printf("%g,%d,%s,%g,%.3f,%.2f,%.3f,%.3f,%d\n",
+                                sampleRate, blockSize, sweep.parameterID, value, result.nsPerSample,
+                                result.worstBlockMicroseconds, result.meanBudgetPercent,
+                                result.worstBudgetPercent, result.peakNumGrains);
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
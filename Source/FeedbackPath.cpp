@@ -0,0 +1,94 @@
+#include "FeedbackPath.h"
+
+namespace
+{
+    float flushToZero(float sample)
+    {
+        return std::abs(sample) < FeedbackPath::flushThreshold ? 0.f : sample;
+    }
+}
+
+//==============================================================================
+void FeedbackPath::prepare(double sampleRate, int numChannels, int maxBlockSize)
+{
+    buffer.setSize(juce::jmin(numChannels, GrainKernels::maxNumChannels), maxBlockSize);
+    gainRamp.allocate(static_cast<size_t>(maxBlockSize), true);
+    gainSmoother.reset(sampleRate, 0.05);
+
+    highpassCoefficient = static_cast<float>(std::exp(-juce::MathConstants<double>::twoPi * highpassHz / sampleRate));
+    lowpassCoefficient = static_cast<float>(1.0 - std::exp(-juce::MathConstants<double>::twoPi * lowpassHz / sampleRate));
+
+    reset(0.f);
+}
+
+void FeedbackPath::reset(float gain)
+{
+    gainSmoother.setCurrentAndTargetValue(gain);
+
+    std::fill(std::begin(highpassInput), std::end(highpassInput), 0.f);
+    std::fill(std::begin(highpassOutput), std::end(highpassOutput), 0.f);
+    std::fill(std::begin(lowpassOutput), std::end(lowpassOutput), 0.f);
+}
+
+float FeedbackPath::process(const juce::AudioBuffer<float>& wet, int numSamples, float gain)
+{
+    jassert(numSamples <= buffer.getNumSamples());
+
+    gainSmoother.setTargetValue(gain);
+    bool isSmoothing = gainSmoother.isSmoothing();
+    auto currentGain = gainSmoother.getCurrentValue();
+
+    if (isSmoothing)
+        for (int i = 0; i < numSamples; ++i)
+            gainRamp[i] = gainSmoother.getNextValue();
+
+    float peak = 0.f;
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        auto* samples = buffer.getWritePointer(channel);
+
+        if (isSmoothing)
+            juce::FloatVectorOperations::multiply(samples, wet.getReadPointer(channel), gainRamp, numSamples);
+        else
+            juce::FloatVectorOperations::multiply(samples, wet.getReadPointer(channel), currentGain, numSamples);
+
+        // The filters depend on their own last output, so they go a sample at a time
+        float previousInput = highpassInput[channel];
+        float highpassed = highpassOutput[channel];
+        float lowpassed = lowpassOutput[channel];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            highpassed = highpassCoefficient * highpassed + samples[i] - previousInput;
+            previousInput = samples[i];
+            lowpassed += lowpassCoefficient * (highpassed - lowpassed);
+            samples[i] = lowpassed;
+        }
+
+        highpassInput[channel] = flushToZero(previousInput);
+        highpassOutput[channel] = flushToZero(highpassed);
+        lowpassOutput[channel] = flushToZero(lowpassed);
+
+        // A rational fit to tanh that is exactly +-1 at +-3, so quiet repeats pass through
+        // untouched and loud ones saturate smoothly. Clipping in its own pass leaves the
+        // shaping and flushing loop without branches, so the compiler vectorises it.
+        juce::FloatVectorOperations::clip(samples, samples, -3.f, 3.f, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float x = samples[i];
+            float limited = x * (27.f + x * x) / (27.f + 9.f * x * x);
+            samples[i] = std::abs(limited) < flushThreshold ? 0.f : limited;
+        }
+
+        auto range = juce::FloatVectorOperations::findMinAndMax(samples, numSamples);
+        peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+    }
+
+    // Once the gain has faded right out, start the filters afresh for next time
+    if (!isActive(gain))
+        reset(0.f);
+
+    return peak;
+}
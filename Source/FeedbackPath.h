@@ -0,0 +1,51 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "GrainKernels.h"
+
+//==============================================================================
+// Turns the grains' output into the signal that's fed back into the delayBuffer, so new
+// grains can be made out of earlier ones. On every pass round the loop the signal goes
+// through a DC blocker and a gentle lowpass, so repeats darken rather than pile up rumble
+// or fizz, then through a soft limiter that keeps the loop bounded however dense the
+// grains get. Anything that decays below flushThreshold is set to exactly zero, in the
+// output and in the filter states, so a dying loop can't leave denormals circulating in
+// the delayBuffer even where ScopedNoDenormals can't switch flush-to-zero on.
+class FeedbackPath
+{
+public:
+    static constexpr float highpassHz = 20.f;
+    static constexpr float lowpassHz = 8000.f;
+
+    // About -300 dBFS, far above where floats turn denormal
+    static constexpr float flushThreshold = 1.0e-15f;
+
+    // Must not be called on the audio thread
+    void prepare(double sampleRate, int numChannels, int maxBlockSize);
+
+    // Clears the filters and jumps straight to the given gain
+    void reset(float gain);
+
+    // Audio thread: whether there's anything to feed back at this gain, counting a fade out
+    bool isActive(float gain) const { return gain > 0.f || gainSmoother.getCurrentValue() > 0.f; }
+
+    // Audio thread: works out numSamples of feedback from the wet signal, ramping smoothly
+    // to a new gain if it has changed, and returns the peak level of the result
+    float process(const juce::AudioBuffer<float>& wet, int numSamples, float gain);
+
+    const float* getReadPointer(int channel) const { return buffer.getReadPointer(channel); }
+
+private:
+    juce::AudioBuffer<float> buffer;
+    juce::HeapBlock<float> gainRamp;
+    juce::SmoothedValue<float> gainSmoother;
+
+    float highpassCoefficient { 0.f };
+    float lowpassCoefficient { 0.f };
+
+    // Filter state for each channel
+    float highpassInput[GrainKernels::maxNumChannels] {};
+    float highpassOutput[GrainKernels::maxNumChannels] {};
+    float lowpassOutput[GrainKernels::maxNumChannels] {};
+};
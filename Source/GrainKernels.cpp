@@ -0,0 +1,578 @@
+#include "GrainKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+ #include <immintrin.h>
+ #define GRAIN_KERNELS_USE_AVX 1
+ #define GRAIN_KERNELS_USE_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define GRAIN_KERNELS_USE_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define GRAIN_KERNELS_USE_NEON 1
+#endif
+
+//==============================================================================
+GrainKernels::RenderPath GrainKernels::getRenderPath(float playbackSpeed, Interpolation interpolation)
+{
+    // At 1x nothing is resampled, so every interpolation gives back the source samples
+    if (exactlyEqual(playbackSpeed, 1.f))
+        return RenderPath::unity;
+
+    switch (interpolation)
+    {
+        case Interpolation::linear:
+            if (exactlyEqual(playbackSpeed, 2.f))
+                return RenderPath::octaveUp;
+
+            if (exactlyEqual(playbackSpeed, 0.5f))
+                return RenderPath::octaveDown;
+
+            return RenderPath::linear;
+
+        case Interpolation::hermite:
+            if (exactlyEqual(playbackSpeed, 2.f))
+                return RenderPath::octaveUp;
+
+            return RenderPath::hermite;
+
+        case Interpolation::sinc:
+        default:
+            return RenderPath::sinc;
+    }
+}
+
+//==============================================================================
+void GrainKernels::SincTable::build(float cutoff)
+{
+    constexpr double pi = 3.14159265358979323846;
+    constexpr double halfWidth = numTaps / 2;
+
+    coefficients.resize(static_cast<size_t>((numPhases + 1) * numTaps));
+
+    for (int phase = 0; phase <= numPhases; ++phase)
+    {
+        double fraction = static_cast<double>(phase) / numPhases;
+        float* phaseCoefficients = coefficients.data() + phase * numTaps;
+        double sum = 0.0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            // Distance from the read position to this tap's sample
+            double x = (tap - tapOffset) - fraction;
+            double sinc = exactlyEqual(x, 0.0) ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+            double window = 0.42 + 0.5 * std::cos(pi * x / halfWidth) + 0.08 * std::cos(2.0 * pi * x / halfWidth);
+            double coefficient = std::abs(x) < halfWidth ? cutoff * sinc * window : 0.0;
+
+            phaseCoefficients[tap] = static_cast<float>(coefficient);
+            sum += coefficient;
+        }
+
+        // Normalise every phase to unity gain at DC
+        for (int tap = 0; tap < numTaps; ++tap)
+            phaseCoefficients[tap] = static_cast<float>(phaseCoefficients[tap] / sum);
+    }
+}
+
+void GrainKernels::SincTables::build()
+{
+    // Leave a little room below Nyquist for the window's transition band
+    constexpr float cutoffMargin = 0.9f;
+
+    for (int i = 0; i < numTables; ++i)
+        tables[i].build(cutoffMargin / maxSpeeds[i]);
+}
+
+const GrainKernels::SincTable* GrainKernels::SincTables::getTable(float playbackSpeed) const
+{
+    for (int i = 0; i < numTables; ++i)
+        if (playbackSpeed <= maxSpeeds[i])
+            return &tables[i];
+
+    return &tables[numTables - 1];
+}
+
+//==============================================================================
+void GrainKernels::WindowTable::build(WindowShape shape)
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    // The Gaussian and the exponential decay never quite reach zero, so they're shifted
+    // down by their value at the ends and scaled back up to a peak of 1
+    auto gaussian = [] (double phase) { return std::exp(-0.5 * std::pow((phase - 0.5) / 0.15, 2.0)); };
+
+    constexpr double attack = 0.05;
+    constexpr double decayRate = 5.0;
+    auto decay = [] (double phase) { return std::exp(-decayRate * (phase - attack) / (1.0 - attack)); };
+    double decayFloor = decay(1.0);
+
+    gains.resize(static_cast<size_t>(tableSize + 1));
+
+    for (int i = 0; i <= tableSize; ++i)
+    {
+        double phase = static_cast<double>(i) / tableSize;
+        double gain = 0.0;
+
+        switch (shape)
+        {
+            case WindowShape::trapezoid:
+                gain = std::min({ 1.0, phase * 5.0, (1.0 - phase) * 5.0 });
+                break;
+
+            case WindowShape::hann:
+                gain = 0.5 - 0.5 * std::cos(2.0 * pi * phase);
+                break;
+
+            case WindowShape::tukey:
+            {
+                double taper = std::min(phase, 1.0 - phase) / 0.25;
+                gain = taper >= 1.0 ? 1.0 : 0.5 - 0.5 * std::cos(pi * taper);
+                break;
+            }
+
+            case WindowShape::gaussian:
+                gain = (gaussian(phase) - gaussian(0.0)) / (1.0 - gaussian(0.0));
+                break;
+
+            case WindowShape::exponentialDecay:
+            default:
+                gain = phase < attack ? phase / attack : (decay(phase) - decayFloor) / (1.0 - decayFloor);
+                break;
+        }
+
+        gains[static_cast<size_t>(i)] = static_cast<float>(gain);
+    }
+}
+
+void GrainKernels::WindowTables::build()
+{
+    for (int i = 0; i < numWindowShapes; ++i)
+        tables[i].build(static_cast<WindowShape>(i));
+}
+
+//==============================================================================
+void GrainKernels::PanTable::build()
+{
+    constexpr double pi = 3.14159265358979323846;
+    static_assert(maxNumChannels == 2, "The pan law only knows about left and right");
+
+    for (auto& table : tables)
+        table.resize(static_cast<size_t>(tableSize + 1));
+
+    for (int i = 0; i <= tableSize; ++i)
+    {
+        // cos and sin keep the summed power constant across the sweep, and the sqrt(2) brings the centre up to 1
+        double angle = 0.5 * pi * static_cast<double>(i) / tableSize;
+        tables[0][static_cast<size_t>(i)] = static_cast<float>(std::sqrt(2.0) * std::cos(angle));
+        tables[1][static_cast<size_t>(i)] = static_cast<float>(std::sqrt(2.0) * std::sin(angle));
+    }
+}
+
+//==============================================================================
+int GrainKernels::computePositions(GrainPositions& positions, int startSample, int grainSizeSamples,
+                                   float playbackSpeed, const WindowTable& window, int ringSize,
+                                   float& readPosition, int numSamples)
+{
+    int ringMask = ringSize - 1;
+    int i = 0;
+
+    for (; i < numSamples && readPosition + 1 < grainSizeSamples; ++i)
+    {
+        int truncatedPos = static_cast<int>(readPosition);
+        int index1 = (startSample + truncatedPos) & ringMask;
+        int index2 = index1 + 1;
+
+        positions.index1[i] = index1;
+        positions.index2[i] = index2;
+        positions.fraction[i] = readPosition - static_cast<float>(truncatedPos);
+        positions.gain[i] = getWindowGain(window, readPosition, grainSizeSamples);
+
+        readPosition += playbackSpeed;
+    }
+
+    return i;
+}
+
+int GrainKernels::computeGains(GrainPositions& positions, int grainSizeSamples, float playbackSpeed,
+                               const WindowTable& window, float& readPosition, int numSamples)
+{
+    int i = 0;
+
+    for (; i < numSamples && readPosition + 1 < grainSizeSamples; ++i)
+    {
+        positions.gain[i] = getWindowGain(window, readPosition, grainSizeSamples);
+        readPosition += playbackSpeed;
+    }
+
+    return i;
+}
+
+//==============================================================================
+int GrainKernels::renderGrain(const float* const* ring, int ringSize, float* const* dest, int numChannels,
+                              const float* channelGains,
+                              int startSample, int grainSizeSamples, float playbackSpeed, RenderPath path,
+                              const SincTable* sincTable, const WindowTable& window, float& readPosition,
+                              GrainPositions& positions, int numSamples)
+{
+    bool isFastPath = path == RenderPath::unity || path == RenderPath::octaveUp || path == RenderPath::octaveDown;
+
+    int numRendered = 0;
+    float* chunkDest[maxNumChannels] {};
+
+    while (numRendered < numSamples)
+    {
+        int chunkSize = std::min(maxChunkSize, numSamples - numRendered);
+        float chunkStartPosition = readPosition;
+        int numInChunk = 0;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            chunkDest[channel] = dest[channel] + numRendered;
+
+        if (isFastPath)
+        {
+            numInChunk = computeGains(positions, grainSizeSamples, playbackSpeed, window, readPosition, chunkSize);
+
+            // The chunk reads contiguously from the sample under the read position, running
+            // into the ring's guard region if it crosses the end
+            int truncatedPos = static_cast<int>(chunkStartPosition);
+            int firstIndex = (startSample + truncatedPos) & (ringSize - 1);
+
+            const float* source[maxNumChannels] {};
+            for (int channel = 0; channel < numChannels; ++channel)
+                source[channel] = ring[channel] + firstIndex;
+
+            if (path == RenderPath::unity)
+                renderUnity(source, chunkDest, numChannels, channelGains, positions.gain, numInChunk);
+            else if (path == RenderPath::octaveUp)
+                renderOctaveUp(source, chunkDest, numChannels, channelGains, positions.gain, numInChunk);
+            else
+                renderOctaveDown(source, chunkDest, numChannels, channelGains, positions.gain,
+                                 chunkStartPosition - static_cast<float>(truncatedPos), numInChunk);
+        }
+        else
+        {
+            numInChunk = computePositions(positions, startSample, grainSizeSamples, playbackSpeed,
+                                          window, ringSize, readPosition, chunkSize);
+
+            if (path == RenderPath::sinc && sincTable != nullptr)
+                renderSinc(ring, chunkDest, numChannels, channelGains, positions, *sincTable, numInChunk);
+            else if (path == RenderPath::hermite)
+                renderHermite(ring, chunkDest, numChannels, channelGains, positions, numInChunk);
+            else
+                renderLinear(ring, chunkDest, numChannels, channelGains, positions, numInChunk);
+        }
+
+        numRendered += numInChunk;
+
+        // The grain finished part way through this chunk
+        if (numInChunk < chunkSize)
+            break;
+    }
+
+    return numRendered;
+}
+
+//==============================================================================
+void GrainKernels::renderLinearScalar(const float* const* source, float* const* dest, int numChannels,
+                                      const float* channelGains, const GrainPositions& positions,
+                                      int startIndex, int numSamples)
+{
+    for (int i = startIndex; i < numSamples; ++i)
+    {
+        float fraction = positions.fraction[i];
+        float gain = positions.gain[i];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float sample1 = source[channel][positions.index1[i]];
+            float sample2 = source[channel][positions.index2[i]];
+            float interpolatedSample = sample1 + (sample2 - sample1) * fraction;
+
+            dest[channel][i] += interpolatedSample * (gain * channelGains[channel]);
+        }
+    }
+}
+
+void GrainKernels::renderLinear(const float* const* source, float* const* dest, int numChannels,
+                                const float* channelGains, const GrainPositions& positions, int numSamples)
+{
+    int i = 0;
+
+   #if GRAIN_KERNELS_USE_AVX
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        auto fraction = _mm256_load_ps(positions.fraction + i);
+        auto gain = _mm256_load_ps(positions.gain + i);
+
+       #if defined(__AVX2__)
+        auto index1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(positions.index1 + i));
+        auto index2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(positions.index2 + i));
+       #endif
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* src = source[channel];
+
+           #if defined(__AVX2__)
+            auto sample1 = _mm256_i32gather_ps(src, index1, 4);
+            auto sample2 = _mm256_i32gather_ps(src, index2, 4);
+           #else
+            const int* i1 = positions.index1 + i;
+            const int* i2 = positions.index2 + i;
+            auto sample1 = _mm256_set_ps(src[i1[7]], src[i1[6]], src[i1[5]], src[i1[4]],
+                                         src[i1[3]], src[i1[2]], src[i1[1]], src[i1[0]]);
+            auto sample2 = _mm256_set_ps(src[i2[7]], src[i2[6]], src[i2[5]], src[i2[4]],
+                                         src[i2[3]], src[i2[2]], src[i2[1]], src[i2[0]]);
+           #endif
+
+            auto interpolated = _mm256_add_ps(sample1, _mm256_mul_ps(_mm256_sub_ps(sample2, sample1), fraction));
+            auto channelGain = _mm256_mul_ps(gain, _mm256_set1_ps(channelGains[channel]));
+            auto out = _mm256_loadu_ps(dest[channel] + i);
+            _mm256_storeu_ps(dest[channel] + i, _mm256_add_ps(out, _mm256_mul_ps(interpolated, channelGain)));
+        }
+    }
+   #elif GRAIN_KERNELS_USE_SSE
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        auto fraction = _mm_load_ps(positions.fraction + i);
+        auto gain = _mm_load_ps(positions.gain + i);
+        const int* i1 = positions.index1 + i;
+        const int* i2 = positions.index2 + i;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* src = source[channel];
+            auto sample1 = _mm_set_ps(src[i1[3]], src[i1[2]], src[i1[1]], src[i1[0]]);
+            auto sample2 = _mm_set_ps(src[i2[3]], src[i2[2]], src[i2[1]], src[i2[0]]);
+
+            auto interpolated = _mm_add_ps(sample1, _mm_mul_ps(_mm_sub_ps(sample2, sample1), fraction));
+            auto channelGain = _mm_mul_ps(gain, _mm_set1_ps(channelGains[channel]));
+            auto out = _mm_loadu_ps(dest[channel] + i);
+            _mm_storeu_ps(dest[channel] + i, _mm_add_ps(out, _mm_mul_ps(interpolated, channelGain)));
+        }
+    }
+   #elif GRAIN_KERNELS_USE_NEON
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        auto fraction = vld1q_f32(positions.fraction + i);
+        auto gain = vld1q_f32(positions.gain + i);
+        const int* i1 = positions.index1 + i;
+        const int* i2 = positions.index2 + i;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* src = source[channel];
+            const float gathered1[4] = { src[i1[0]], src[i1[1]], src[i1[2]], src[i1[3]] };
+            const float gathered2[4] = { src[i2[0]], src[i2[1]], src[i2[2]], src[i2[3]] };
+            auto sample1 = vld1q_f32(gathered1);
+            auto sample2 = vld1q_f32(gathered2);
+
+            auto interpolated = vaddq_f32(sample1, vmulq_f32(vsubq_f32(sample2, sample1), fraction));
+            auto channelGain = vmulq_n_f32(gain, channelGains[channel]);
+            auto out = vld1q_f32(dest[channel] + i);
+            vst1q_f32(dest[channel] + i, vaddq_f32(out, vmulq_f32(interpolated, channelGain)));
+        }
+    }
+   #endif
+
+    // Whatever doesn't fill a whole vector goes through the scalar version
+    renderLinearScalar(source, dest, numChannels, channelGains, positions, i, numSamples);
+}
+
+//==============================================================================
+void GrainKernels::renderHermite(const float* const* ring, float* const* dest, int numChannels,
+                                 const float* channelGains, const GrainPositions& positions, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        int index = positions.index1[i];
+        float fraction = positions.fraction[i];
+        float gain = positions.gain[i];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            // The four samples around the read position
+            const float* src = ring[channel] + index;
+            float previous = src[-1];
+            float current = src[0];
+            float next = src[1];
+            float afterNext = src[2];
+
+            float c1 = 0.5f * (next - previous);
+            float c2 = previous - 2.5f * current + 2.f * next - 0.5f * afterNext;
+            float c3 = 0.5f * (afterNext - previous) + 1.5f * (current - next);
+            float interpolatedSample = ((c3 * fraction + c2) * fraction + c1) * fraction + current;
+
+            dest[channel][i] += interpolatedSample * (gain * channelGains[channel]);
+        }
+    }
+}
+
+void GrainKernels::renderSinc(const float* const* ring, float* const* dest, int numChannels,
+                              const float* channelGains, const GrainPositions& positions,
+                              const SincTable& table, int numSamples)
+{
+    constexpr int numTaps = SincTable::numTaps;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Interpolate between the two nearest phases of the table
+        float phasePosition = positions.fraction[i] * SincTable::numPhases;
+        int phase = std::min(static_cast<int>(phasePosition), SincTable::numPhases - 1);
+        float phaseFraction = phasePosition - static_cast<float>(phase);
+        const float* lower = table.getPhase(phase);
+        const float* upper = table.getPhase(phase + 1);
+
+        float coefficients[numTaps];
+        for (int tap = 0; tap < numTaps; ++tap)
+            coefficients[tap] = (lower[tap] + (upper[tap] - lower[tap]) * phaseFraction) * positions.gain[i];
+
+        int firstIndex = positions.index1[i] - SincTable::tapOffset;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* taps = ring[channel] + firstIndex;
+            float sum = 0.f;
+
+            for (int tap = 0; tap < numTaps; ++tap)
+                sum += taps[tap] * coefficients[tap];
+
+            dest[channel][i] += sum * channelGains[channel];
+        }
+    }
+}
+
+//==============================================================================
+void GrainKernels::renderUnity(const float* const* source, float* const* dest, int numChannels,
+                               const float* channelGains, const float* gain, int numSamples)
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* src = source[channel];
+        float* out = dest[channel];
+        float panGain = channelGains[channel];
+        int i = 0;
+
+       #if GRAIN_KERNELS_USE_SSE
+        auto pan = _mm_set1_ps(panGain);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            auto sample = _mm_loadu_ps(src + i);
+            auto g = _mm_mul_ps(_mm_load_ps(gain + i), pan);
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(sample, g)));
+        }
+       #elif GRAIN_KERNELS_USE_NEON
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            auto sample = vld1q_f32(src + i);
+            auto g = vmulq_n_f32(vld1q_f32(gain + i), panGain);
+            vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(sample, g)));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            out[i] += src[i] * (gain[i] * panGain);
+    }
+}
+
+void GrainKernels::renderOctaveUp(const float* const* source, float* const* dest, int numChannels,
+                                  const float* channelGains, const float* gain, int numSamples)
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* src = source[channel];
+        float* out = dest[channel];
+        float panGain = channelGains[channel];
+        int i = 0;
+
+        // Every vector reads 8 source samples, so leave the last few to the scalar loop
+       #if GRAIN_KERNELS_USE_SSE
+        auto pan = _mm_set1_ps(panGain);
+
+        for (; i + 4 < numSamples; i += 4)
+        {
+            auto evens = _mm_shuffle_ps(_mm_loadu_ps(src + 2 * i), _mm_loadu_ps(src + 2 * i + 4), _MM_SHUFFLE(2, 0, 2, 0));
+            auto g = _mm_mul_ps(_mm_load_ps(gain + i), pan);
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(evens, g)));
+        }
+       #elif GRAIN_KERNELS_USE_NEON
+        for (; i + 4 < numSamples; i += 4)
+        {
+            auto evens = vld2q_f32(src + 2 * i).val[0];
+            auto g = vmulq_n_f32(vld1q_f32(gain + i), panGain);
+            vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(evens, g)));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+            out[i] += src[2 * i] * (gain[i] * panGain);
+    }
+}
+
+void GrainKernels::renderOctaveDown(const float* const* source, float* const* dest, int numChannels,
+                                    const float* channelGains, const float* gain, float startFraction,
+                                    int numSamples)
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* src = source[channel];
+        const float* g = gain;
+        float* out = dest[channel];
+        float panGain = channelGains[channel];
+        int n = numSamples;
+        int i = 0;
+
+        // Line up on a whole source sample, so even outputs land on samples and odd ones halfway between
+        if (!exactlyEqual(startFraction, 0.f) && n > 0)
+        {
+            out[0] += (src[0] + (src[1] - src[0]) * 0.5f) * (g[0] * panGain);
+            ++src;
+            ++out;
+            ++g;
+            --n;
+        }
+
+       #if GRAIN_KERNELS_USE_SSE
+        auto half = _mm_set1_ps(0.5f);
+        auto pan = _mm_set1_ps(panGain);
+
+        for (; i + 8 <= n; i += 8)
+        {
+            auto current = _mm_loadu_ps(src + i / 2);
+            auto next = _mm_loadu_ps(src + i / 2 + 1);
+            auto between = _mm_add_ps(current, _mm_mul_ps(_mm_sub_ps(next, current), half));
+
+            auto low = _mm_mul_ps(_mm_unpacklo_ps(current, between), _mm_mul_ps(_mm_loadu_ps(g + i), pan));
+            auto high = _mm_mul_ps(_mm_unpackhi_ps(current, between), _mm_mul_ps(_mm_loadu_ps(g + i + 4), pan));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), low));
+            _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), high));
+        }
+       #elif GRAIN_KERNELS_USE_NEON
+        auto half = vdupq_n_f32(0.5f);
+
+        for (; i + 8 <= n; i += 8)
+        {
+            auto current = vld1q_f32(src + i / 2);
+            auto next = vld1q_f32(src + i / 2 + 1);
+            auto between = vaddq_f32(current, vmulq_f32(vsubq_f32(next, current), half));
+            auto zipped = vzipq_f32(current, between);
+
+            auto low = vmulq_n_f32(vld1q_f32(g + i), panGain);
+            auto high = vmulq_n_f32(vld1q_f32(g + i + 4), panGain);
+            vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(zipped.val[0], low)));
+            vst1q_f32(out + i + 4, vaddq_f32(vld1q_f32(out + i + 4), vmulq_f32(zipped.val[1], high)));
+        }
+       #endif
+
+        for (; i < n; ++i)
+        {
+            const float* sample = src + i / 2;
+            float interpolatedSample = (i % 2 == 0) ? sample[0] : sample[0] + (sample[1] - sample[0]) * 0.5f;
+            out[i] += interpolatedSample * (g[i] * panGain);
+        }
+    }
+}
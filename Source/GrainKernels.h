@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+//==============================================================================
+// The inner loops used to render grains. Rendering happens in two steps: the read
+// positions for a run of output samples are worked out once per grain, then a
+// kernel reads every channel of the grain from the delayBuffer ring in a single
+// pass over those positions. The ring's size must be a power of two, so wrapping an
+// index around it is a mask, and each ring channel must be readable for at least
+// minRingGuardSize samples either side of its ends with the samples from the other
+// end (see RingBuffer), so the kernels never have to wrap a read themselves.
+// Everything here works on raw pointers and doesn't depend on JUCE, so the
+// benchmarks can build it on its own.
+namespace GrainKernels
+{
+    // Compares two values for exact equality without tripping -Wfloat-equal, the same way
+    // juce::exactlyEqual does, for the places where exact equality is what's meant
+    template <typename Type>
+    constexpr bool exactlyEqual(Type a, Type b)
+    {
+        return std::equal_to<Type>()(a, b);
+    }
+
+    // The processor renders grains in blocks of this many samples (its subBlockSize). It
+    // lives here so the benchmarks can time the kernels at the size they really run at.
+    static constexpr int subBlockSize = 64;
+
+    // The most output samples whose positions are worked out in one go
+    static constexpr int maxChunkSize = 128;
+
+    // The most channels a kernel renders in one pass
+    static constexpr int maxNumChannels = 2;
+
+    // How far past either end of the ring a kernel can read. The octaveUp fast path
+    // reads furthest, at two source samples per output sample for a whole chunk.
+    static constexpr int minRingGuardSize = 2 * maxChunkSize;
+
+    // How pitched grains are interpolated between samples in the delayBuffer
+    enum class Interpolation
+    {
+        linear,
+        hermite,
+        sinc
+    };
+
+    // Which kernel renders a grain. This is picked once when the grain starts: speeds
+    // of exactly 1, 2 and 0.5 read whole (or half) samples, so they get their own
+    // kernels that skip most of the interpolation work when the interpolation allows it.
+    enum class RenderPath
+    {
+        linear,
+        hermite,
+        sinc,
+        unity,
+        octaveUp,
+        octaveDown
+    };
+
+    RenderPath getRenderPath(float playbackSpeed, Interpolation interpolation);
+
+    // The envelope shapes a grain can be faded in and out with
+    enum class WindowShape
+    {
+        trapezoid,       // Linear fades over the first and last fifth of the grain
+        hann,
+        tukey,           // Cosine fades over the first and last quarter of the grain
+        gaussian,
+        exponentialDecay // A short attack, then a decay to silence by the end of the grain
+    };
+
+    static constexpr int numWindowShapes = 5;
+
+    //==============================================================================
+    // A polyphase windowed-sinc interpolation table with a fixed cutoff. Each phase holds
+    // numTaps coefficients for the samples at offsets -7 to +8 around the read position,
+    // and there is one extra phase so neighbouring phases can be interpolated.
+    class SincTable
+    {
+    public:
+        static constexpr int numTaps = 16;
+        static constexpr int numPhases = 256;
+        static constexpr int tapOffset = numTaps / 2 - 1;
+
+        // Fills in the table for a cutoff given as a fraction of the source Nyquist frequency
+        void build(float cutoff);
+
+        const float* getPhase(int phase) const { return coefficients.data() + phase * numTaps; }
+
+    private:
+        std::vector<float> coefficients;
+    };
+
+    // A set of sinc tables, one per band of playback speeds. Grains faster than 1x need
+    // a lower cutoff to keep the skipped-over high frequencies from aliasing.
+    class SincTables
+    {
+    public:
+        static constexpr int numTables = 6;
+
+        void build();
+
+        // Returns the table to use for a grain at the given playback speed
+        const SincTable* getTable(float playbackSpeed) const;
+
+    private:
+        static constexpr float maxSpeeds[numTables] = { 1.f, 1.5f, 2.f, 3.f, 4.f, 6.f };
+        SincTable tables[numTables];
+    };
+
+    //==============================================================================
+    // A grain envelope sampled at tableSize + 1 evenly spaced points from the start of the
+    // grain to its end, so that the gain at any point through a grain is a table lookup
+    // whatever the grain's length. Every shape starts and ends at exactly zero.
+    class WindowTable
+    {
+    public:
+        static constexpr int tableSize = 1024;
+
+        void build(WindowShape shape);
+
+        // Returns the gain at the given phase through the grain, from 0 to 1, interpolating
+        // between the two nearest points of the table
+        float getGain(float phase) const
+        {
+            float position = phase * tableSize;
+            int index = std::min(static_cast<int>(position), tableSize - 1);
+            float fraction = position - static_cast<float>(index);
+            return gains[static_cast<size_t>(index)]
+                 + (gains[static_cast<size_t>(index + 1)] - gains[static_cast<size_t>(index)]) * fraction;
+        }
+
+    private:
+        std::vector<float> gains;
+    };
+
+    // One table per window shape
+    class WindowTables
+    {
+    public:
+        void build();
+
+        const WindowTable* getTable(WindowShape shape) const { return &tables[static_cast<int>(shape)]; }
+
+    private:
+        WindowTable tables[numWindowShapes];
+    };
+
+    //==============================================================================
+    // A constant-power pan law sampled at tableSize + 1 points from hard left (-1) to hard
+    // right (+1). The gains are scaled so that the centre is exactly 1 in both channels,
+    // which leaves an unpanned grain sounding the same as before it could be panned.
+    class PanTable
+    {
+    public:
+        static constexpr int tableSize = 256;
+
+        void build();
+
+        // Fills in the left and right gains for a pan position from -1 to 1
+        void getGains(float pan, float* channelGains) const
+        {
+            float position = (std::clamp(pan, -1.f, 1.f) + 1.f) * 0.5f * tableSize;
+            int index = std::min(static_cast<int>(position), tableSize - 1);
+            float fraction = position - static_cast<float>(index);
+
+            for (int channel = 0; channel < maxNumChannels; ++channel)
+            {
+                const float* gains = tables[channel].data();
+                channelGains[channel] = gains[index] + (gains[index + 1] - gains[index]) * fraction;
+            }
+        }
+
+    private:
+        std::vector<float> tables[maxNumChannels];
+    };
+
+    //==============================================================================
+    // Ring indices, interpolation fractions and gains for a run of output samples
+    struct GrainPositions
+    {
+        alignas(32) int index1[maxChunkSize];
+        alignas(32) int index2[maxChunkSize];
+        alignas(32) float fraction[maxChunkSize];
+        alignas(32) float gain[maxChunkSize];
+    };
+
+    // Returns the gain a grain plays at when readPosition samples into it
+    inline float getWindowGain(const WindowTable& window, float readPosition, int grainSizeSamples)
+    {
+        return window.getGain(readPosition * (1.f / static_cast<float>(grainSizeSamples))) * 0.5f; // Could replace with a parameter?
+    }
+
+    // Fills in positions for up to numSamples output samples of a grain, starting from
+    // readPosition and advancing it as it goes, with gains looked up from the window.
+    // Stops early when the grain finishes, and returns how many samples were filled in.
+    int computePositions(GrainPositions& positions, int startSample, int grainSizeSamples,
+                         float playbackSpeed, const WindowTable& window, int ringSize,
+                         float& readPosition, int numSamples);
+
+    // Same as computePositions(), but only fills in the gains (for the fast paths)
+    int computeGains(GrainPositions& positions, int grainSizeSamples, float playbackSpeed,
+                     const WindowTable& window, float& readPosition, int numSamples);
+
+    // Renders up to numSamples of a grain from the ring into dest with the kernel for its
+    // render path, advancing readPosition. Returns how many samples were rendered, which is
+    // fewer than numSamples if the grain finished. Every kernel scales each dest channel by
+    // its entry in channelGains as it mixes, which is how grains are panned.
+    int renderGrain(const float* const* ring, int ringSize, float* const* dest, int numChannels,
+                    const float* channelGains,
+                    int startSample, int grainSizeSamples, float playbackSpeed, RenderPath path,
+                    const SincTable* sincTable, const WindowTable& window, float& readPosition,
+                    GrainPositions& positions, int numSamples);
+
+    // Adds numSamples of linearly interpolated grain output to every dest channel,
+    // reading from the matching source channel. The vectorised version uses SSE/AVX
+    // or NEON where the compiler targets them, and gives the same output as the
+    // scalar version, which is also used as the fallback.
+    void renderLinear(const float* const* source, float* const* dest, int numChannels,
+                      const float* channelGains, const GrainPositions& positions, int numSamples);
+    void renderLinearScalar(const float* const* source, float* const* dest, int numChannels,
+                            const float* channelGains, const GrainPositions& positions,
+                            int startIndex, int numSamples);
+
+    // The higher quality kernels. These read the taps around each position straight from
+    // the ring, running into its guard regions near the ends.
+    void renderHermite(const float* const* ring, float* const* dest, int numChannels,
+                       const float* channelGains, const GrainPositions& positions, int numSamples);
+    void renderSinc(const float* const* ring, float* const* dest, int numChannels,
+                    const float* channelGains, const GrainPositions& positions,
+                    const SincTable& table, int numSamples);
+
+    // The fast paths. Each source pointer points at the sample under the grain's read
+    // position, and reads carry on contiguously from there into the ring's guard region.
+    // They give the same output as renderLinear() would at the same speed (and as
+    // renderHermite() for unity and octaveUp, where every read lands on a whole sample).
+    void renderUnity(const float* const* source, float* const* dest, int numChannels,
+                     const float* channelGains, const float* gain, int numSamples);
+    void renderOctaveUp(const float* const* source, float* const* dest, int numChannels,
+                        const float* channelGains, const float* gain, int numSamples);
+    void renderOctaveDown(const float* const* source, float* const* dest, int numChannels,
+                          const float* channelGains, const float* gain, float startFraction,
+                          int numSamples);
+}
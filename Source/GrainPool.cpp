@@ -0,0 +1,75 @@
+#include "GrainPool.h"
+
+//==============================================================================
+// Allocates every grain the pool can ever hand out. Must not be called on the audio thread.
+void GrainPool::prepare(int newMaxNumGrains)
+{
+    maxNumGrains = newMaxNumGrains;
+
+    slot.allocate(static_cast<size_t>(maxNumGrains), true);
+    startSample.allocate(static_cast<size_t>(maxNumGrains), true);
+    numSamples.allocate(static_cast<size_t>(maxNumGrains), true);
+    blockOffset.allocate(static_cast<size_t>(maxNumGrains), true);
+    readPosition.allocate(static_cast<size_t>(maxNumGrains), true);
+    playbackSpeed.allocate(static_cast<size_t>(maxNumGrains), true);
+    renderPath.allocate(static_cast<size_t>(maxNumGrains), true);
+    sincTable.allocate(static_cast<size_t>(maxNumGrains), true);
+    window.allocate(static_cast<size_t>(maxNumGrains), true);
+    channelGains.allocate(static_cast<size_t>(maxNumGrains * GrainKernels::maxNumChannels), true);
+    freeSlots.allocate(static_cast<size_t>(maxNumGrains), true);
+
+    clear();
+}
+
+// Returns every grain to the free list
+void GrainPool::clear()
+{
+    for (int i = 0; i < maxNumGrains; ++i)
+        freeSlots[i] = maxNumGrains - 1 - i;
+
+    numActive = 0;
+}
+
+int GrainPool::add()
+{
+    if (numActive >= maxNumGrains)
+        return -1;
+
+    int index = numActive++;
+
+    slot[index] = freeSlots[maxNumGrains - numActive];
+    startSample[index] = 0;
+    numSamples[index] = 0;
+    blockOffset[index] = 0;
+    readPosition[index] = 0;
+    playbackSpeed[index] = 1.f;
+    renderPath[index] = GrainKernels::RenderPath::unity;
+    sincTable[index] = nullptr;
+    window[index] = nullptr;
+    std::fill_n(getChannelGains(index), GrainKernels::maxNumChannels, 1.f);
+
+    return index;
+}
+
+// Frees the grain's slot and moves the last live grain into its place
+void GrainPool::release(int index)
+{
+    jassert(index >= 0 && index < numActive);
+
+    freeSlots[maxNumGrains - numActive] = slot[index];
+    int last = --numActive;
+
+    if (index == last)
+        return;
+
+    slot[index] = slot[last];
+    startSample[index] = startSample[last];
+    numSamples[index] = numSamples[last];
+    blockOffset[index] = blockOffset[last];
+    readPosition[index] = readPosition[last];
+    playbackSpeed[index] = playbackSpeed[last];
+    renderPath[index] = renderPath[last];
+    sincTable[index] = sincTable[last];
+    window[index] = window[last];
+    std::copy_n(getChannelGains(last), GrainKernels::maxNumChannels, getChannelGains(index));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "GrainKernels.h"
+
+//==============================================================================
+// Fixed-capacity storage for the live grains, kept as one array per field so the render
+// loop streams through contiguous memory rather than hopping between grain structs.
+// The live grains are always packed into indices 0 to size() - 1: releasing a grain
+// moves the last live grain into its place, so iterate backwards when releasing in a
+// loop. Every array is allocated up front in prepare(), so add() and release() are
+// O(1) and never allocate, lock or shift memory on the audio thread.
+//
+// A grain doesn't own any audio. It reads its window straight out of the delayBuffer
+// ring, starting at startSample and wrapping around the end of the ring.
+class GrainPool
+{
+public:
+    void prepare(int maxNumGrains);
+    void clear();
+
+    // Adds a grain at index size() with its fields reset, and returns that index, or -1
+    // if every grain is already playing
+    int add();
+    void release(int index);
+
+    int size() const { return numActive; }
+    int capacity() const { return maxNumGrains; }
+    bool empty() const { return numActive == 0; }
+
+    bool isFinished(int index) const { return readPosition[index] + 1 >= numSamples[index]; }
+
+    // The gain the grain is mixed into each output channel at, which is where it's panned
+    float* getChannelGains(int index) const
+    {
+        return channelGains.getData() + index * GrainKernels::maxNumChannels;
+    }
+
+    // One entry per live grain
+    juce::HeapBlock<int> slot;        // Unlike its index, this doesn't change while the grain plays
+    juce::HeapBlock<int> startSample;
+    juce::HeapBlock<int> numSamples;
+    juce::HeapBlock<int> blockOffset; // Samples into the current block before the grain starts playing
+    juce::HeapBlock<float> readPosition;
+    juce::HeapBlock<float> playbackSpeed;
+    juce::HeapBlock<GrainKernels::RenderPath> renderPath;
+    juce::HeapBlock<const GrainKernels::SincTable*> sincTable;
+    juce::HeapBlock<const GrainKernels::WindowTable*> window;
+    juce::HeapBlock<float> channelGains; // maxNumChannels entries per grain, see getChannelGains()
+
+private:
+    juce::HeapBlock<int> freeSlots; // The first maxNumGrains - numActive entries are the slots not in use
+    int maxNumGrains { 0 };
+    int numActive { 0 };
+};
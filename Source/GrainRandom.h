@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+//==============================================================================
+// A small, fast random number generator (xoshiro128+) for the per-grain choices made
+// on the audio thread. Unlike juce::Random it is seeded explicitly rather than from
+// the clock, so the same seed always gives the same sequence of grains, and taking a
+// number costs a handful of integer operations.
+class GrainRandom
+{
+public:
+    GrainRandom() { setSeed(0); }
+
+    // Restarts the sequence. Every seed, including 0, gives a different sequence.
+    void setSeed(uint64_t seed)
+    {
+        // Spread the seed over the whole state with splitmix64, which never leaves it all zero
+        for (int i = 0; i < 4; i += 2)
+        {
+            seed += 0x9e3779b97f4a7c15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            z ^= z >> 31;
+
+            state[i] = static_cast<uint32_t>(z);
+            state[i + 1] = static_cast<uint32_t>(z >> 32);
+        }
+    }
+
+    uint32_t nextUint32()
+    {
+        uint32_t result = state[0] + state[3];
+        uint32_t t = state[1] << 9;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = (state[3] << 11) | (state[3] >> 21);
+
+        return result;
+    }
+
+    // Returns a value from 0 up to (but not including) 1
+    float nextFloat()
+    {
+        // The top 24 bits are the best mixed, and exactly fill a float's mantissa
+        return static_cast<float>(nextUint32() >> 8) * (1.f / 16777216.f);
+    }
+
+private:
+    uint32_t state[4];
+};
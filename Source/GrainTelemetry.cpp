@@ -0,0 +1,44 @@
+#include "GrainTelemetry.h"
+
+//==============================================================================
+void GrainTelemetry::prepare(double sampleRate)
+{
+    samplesPerPlayheadUpdate = juce::jmax(1, juce::roundToInt(sampleRate / playheadUpdatesPerSecond));
+    samplesSinceLastUpdate = 0;
+}
+
+bool GrainTelemetry::advance(int numSamples)
+{
+    samplesSinceLastUpdate += numSamples;
+
+    if (samplesSinceLastUpdate < samplesPerPlayheadUpdate)
+        return false;
+
+    samplesSinceLastUpdate %= samplesPerPlayheadUpdate;
+    return true;
+}
+
+void GrainTelemetry::push(const Event& event)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        events[static_cast<size_t>(start1)] = event;
+    else if (size2 > 0)
+        events[static_cast<size_t>(start2)] = event;
+
+    fifo.finishedWrite(size1 + size2);
+}
+
+int GrainTelemetry::pull(Event* dest, int maxEvents)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(maxEvents, start1, size1, start2, size2);
+
+    std::copy_n(events.begin() + start1, size1, dest);
+    std::copy_n(events.begin() + start2, size2, dest + size1);
+
+    fifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
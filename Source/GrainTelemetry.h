@@ -0,0 +1,63 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//==============================================================================
+// Carries grain events from the audio thread to the editor's grain cloud display. The
+// audio thread writes an event when a grain spawns, updates each grain's playhead a
+// few dozen times a second, and writes an event when a grain ends. Events go through
+// a single-producer, single-consumer FIFO, so writing one never waits: if the editor
+// falls behind, new events are dropped. Like WaveformFeed, the editor switches the
+// telemetry on while it's open and the audio thread skips all of it otherwise.
+class GrainTelemetry
+{
+public:
+    struct Event
+    {
+        enum class Type
+        {
+            spawn,
+            playhead,
+            end
+        };
+
+        Type type = Type::spawn;
+        int slot = 0;         // The grain's slot in the GrainPool, which doesn't change while it plays
+        float delayMs = 0.f;  // How far behind the write head the grain's playhead is reading
+        float sizeMs = 0.f;
+        float speed = 1.f;
+        float progress = 0.f; // How far through the grain the playhead is, from 0 to 1
+        float gain = 0.f;     // The grain's window at the playhead, whichever shape it was spawned with
+    };
+
+    // How often the audio thread sends playhead updates
+    static constexpr double playheadUpdatesPerSecond = 60.0;
+
+    static constexpr int fifoSize = 8192;
+
+    // Must not be called on the audio thread
+    void prepare(double sampleRate);
+
+    // Audio thread: whether anyone is listening. Check this before working out any events.
+    bool isActive() const { return active.load(std::memory_order_relaxed); }
+
+    // Audio thread: returns true once per playhead update period, counting the samples processed
+    bool advance(int numSamples);
+
+    // Audio thread: writes an event, or drops it if the FIFO is full
+    void push(const Event& event);
+
+    // Editor
+    void setActive(bool shouldBeActive) { active.store(shouldBeActive); }
+    int pull(Event* dest, int maxEvents);
+
+private:
+    juce::AbstractFifo fifo { fifoSize };
+    std::vector<Event> events = std::vector<Event>(static_cast<size_t>(fifoSize));
+
+    std::atomic<bool> active { false };
+
+    // Only touched by the audio thread
+    int samplesPerPlayheadUpdate { 1 };
+    int samplesSinceLastUpdate { 0 };
+};
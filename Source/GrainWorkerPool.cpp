@@ -0,0 +1,240 @@
+#include "GrainWorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#elif defined(__APPLE__)
+ #include <pthread.h>
+ #include <sys/qos.h>
+#elif defined(__unix__)
+ #include <pthread.h>
+ #include <sched.h>
+#endif
+
+namespace
+{
+    // Tells the CPU we're in a spin loop, so it can go easy on the other hyperthread
+    inline void spinPause()
+    {
+       #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        _mm_pause();
+       #elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+       #endif
+    }
+
+    // Lifts the calling thread above every ordinary thread, the way juce::Thread's realtime
+    // option does. Any realtime priority is enough for that, so Linux asks for the lowest one.
+    // Where that isn't allowed (Linux without an rtprio limit) the thread carries on as it was.
+    void raiseCurrentThreadPriority()
+    {
+       #if defined(_WIN32)
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+       #elif defined(__APPLE__)
+        pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+       #elif defined(__unix__)
+        sched_param param {};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+       #endif
+    }
+
+    // How long an idle worker keeps spinning before it starts sleeping between checks.
+    // This is a few blocks at common block sizes, so a worker stays hot through a dense cloud.
+    constexpr auto spinTimeout = std::chrono::milliseconds(50);
+    constexpr int spinsBetweenClockChecks = 1024;
+}
+
+//==============================================================================
+GrainWorkerPool::~GrainWorkerPool()
+{
+    stop();
+}
+
+int GrainWorkerPool::getDefaultNumWorkers()
+{
+    auto numCores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(numCores - 1, 0, 3);
+}
+
+void GrainWorkerPool::start(int newNumWorkers, int newNumChannels, int newMaxBlockSize)
+{
+    stop();
+
+    maxBlockSize = newMaxBlockSize;
+    shouldExit.store(false);
+
+    for (int i = 0; i < newNumWorkers; ++i)
+    {
+        auto worker = std::make_unique<Worker>();
+        worker->accumulator.assign(static_cast<size_t>(newNumChannels * newMaxBlockSize), 0.f);
+        workers.push_back(std::move(worker));
+    }
+
+    // Start the threads once the vector won't move any more
+    for (auto& worker : workers)
+        worker->thread = std::thread([this, w = worker.get()] { runWorker(*w); });
+
+    running.store(true);
+}
+
+void GrainWorkerPool::stop()
+{
+    // Keep the audio thread out, and let it finish any block it's already in
+    running.store(false);
+
+    while (rendering.load())
+        std::this_thread::yield();
+
+    shouldExit.store(true);
+
+    for (auto& worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+
+    workers.clear();
+}
+
+//==============================================================================
+bool GrainWorkerPool::render(int newNumGrains, float* const* dest, int newNumChannels, int newNumSamples,
+                             RenderFunction newRenderFunction, void* newContext,
+                             GrainKernels::GrainPositions& positions)
+{
+    rendering.store(true);
+
+    if (!running.load() || workers.empty() || newNumSamples > maxBlockSize)
+    {
+        rendering.store(false);
+        return false;
+    }
+
+    // Close the last block to latecomers, then wait for any worker still looking at it
+    // (which has at most a failed fetch of the job counter left to do) to leave
+    auto blockGeneration = generation.fetch_add(1) + 1;
+
+    while (numActiveWorkers.load() != 0)
+        spinPause();
+
+    numGrains = newNumGrains;
+    numJobs = (newNumGrains + grainsPerJob - 1) / grainsPerJob;
+    numChannels = std::min(newNumChannels, GrainKernels::maxNumChannels);
+    numSamples = newNumSamples;
+    renderFunction = newRenderFunction;
+    context = newContext;
+    nextJob.store(0);
+    numJobsDone.store(0);
+
+    // Publish the block to the workers
+    generation.store(++blockGeneration);
+
+    runJobs(dest, positions, nullptr);
+
+    // Wait for the workers to finish the jobs they took, which is at most a few grains each.
+    // Workers that haven't woken up yet aren't waited for, they just find no jobs left.
+    while (numJobsDone.load(std::memory_order_acquire) != numJobs)
+        spinPause();
+
+    for (auto& worker : workers)
+    {
+        if (worker->outputGeneration.load(std::memory_order_relaxed) != blockGeneration)
+            continue;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* partial = worker->accumulator.data() + channel * maxBlockSize;
+            std::transform(dest[channel], dest[channel] + numSamples, partial, dest[channel], std::plus<float>());
+        }
+    }
+
+    rendering.store(false);
+    return true;
+}
+
+// Takes jobs until there are none left. The audio thread renders straight into dest,
+// and workers into their accumulators, which are only cleared if they get any work.
+void GrainWorkerPool::runJobs(float* const* dest, GrainKernels::GrainPositions& positions, Worker* worker)
+{
+    float* workerDest[GrainKernels::maxNumChannels] {};
+
+    for (int job = nextJob.fetch_add(1, std::memory_order_relaxed); job < numJobs;
+         job = nextJob.fetch_add(1, std::memory_order_relaxed))
+    {
+        if (worker != nullptr && dest == nullptr)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                workerDest[channel] = worker->accumulator.data() + channel * maxBlockSize;
+                std::fill(workerDest[channel], workerDest[channel] + numSamples, 0.f);
+            }
+
+            dest = workerDest;
+            worker->outputGeneration.store(generation.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        int lastGrain = std::min((job + 1) * grainsPerJob, numGrains);
+
+        for (int grain = job * grainsPerJob; grain < lastGrain; ++grain)
+            renderFunction(context, grain, dest, numChannels, numSamples, positions);
+
+        numJobsDone.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void GrainWorkerPool::runWorker(Worker& worker)
+{
+    raiseCurrentThreadPriority();
+
+    auto seenGeneration = generation.load();
+
+    while (true)
+    {
+        auto idleSince = std::chrono::steady_clock::now();
+        int spins = 0;
+        unsigned int blockGeneration;
+
+        // Wait for the next published block
+        while ((blockGeneration = generation.load()) == seenGeneration || (blockGeneration & 1u) != 0)
+        {
+            if (shouldExit.load(std::memory_order_relaxed))
+                return;
+
+            if (++spins < spinsBetweenClockChecks)
+            {
+                spinPause();
+                continue;
+            }
+
+            spins = 0;
+
+            if (std::chrono::steady_clock::now() - idleSince < spinTimeout)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        // Check in, then make sure the block wasn't closed in the meantime. The audio thread
+        // closes a block before waiting for workers to check out, so one of the two always
+        // sees the other.
+        numActiveWorkers.fetch_add(1);
+
+        if (generation.load() == blockGeneration)
+        {
+            seenGeneration = blockGeneration;
+            runJobs(nullptr, worker.positions, &worker);
+        }
+
+        numActiveWorkers.fetch_sub(1);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "GrainKernels.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+// A small pool of worker threads that help the audio thread render very dense grain
+// clouds. Each block the live grains are split into jobs of a few grains, and the audio
+// thread and the workers take jobs from a shared atomic counter until none are left.
+// Workers render into their own accumulation buffers, which are summed into the
+// audio thread's output once every job is done.
+//
+// Everything a block needs is allocated in start(), and handing out work only touches
+// atomics, so render() never allocates or locks. Workers spin while blocks keep coming
+// and back off to short sleeps once they have been idle for a while, so a running pool
+// isn't free: only keep it started while it's wanted.
+//
+// The audio thread waits for the workers to finish the grains they took, so a worker
+// preempted by some ordinary thread would hold up the audio. Each worker raises itself
+// to a realtime priority when it starts, where the system allows it. The workers are
+// std::threads rather than juce::Threads so GrainKernelBenchmark can build the pool.
+class GrainWorkerPool
+{
+public:
+    // Renders the grain at grainIndex into dest, whose pointers point at the start of the block
+    using RenderFunction = void (*)(void* context, int grainIndex, float* const* dest, int numChannels,
+                                    int numSamples, GrainKernels::GrainPositions& positions);
+
+    // Below this many grains, handing out the work is assumed to cost more than it saves.
+    // This is still a guess: GrainKernelBenchmark finds the real threshold at the processor's
+    // 64-sample sub-blocks, but needs a machine with spare cores to run on. On a single core
+    // it measures about 0.5 us per linear grain per sub-block, so 48 grains are some 25 us
+    // of work to split, well above what waking the workers and summing their buffers should
+    // cost, while sparse clouds are left alone.
+    static constexpr int minGrainsForWorkers = 48;
+
+    ~GrainWorkerPool();
+
+    // Starts numWorkers threads with room for blocks of up to maxBlockSize samples.
+    // start() and stop() must not be called on the audio thread, and not from two threads at once.
+    void start(int numWorkers, int numChannels, int maxBlockSize);
+    void stop();
+
+    // Whether the pool has been started (even with no workers) and not stopped since
+    bool isRunning() const { return running.load(); }
+
+    // Must not be called on the audio thread, where the pool could be stopping
+    int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+    // Returns a sensible number of workers for this machine, leaving a core for the audio thread
+    static int getDefaultNumWorkers();
+
+    // Renders grains 0 to numGrains - 1 and adds them into dest. The calling thread
+    // renders its share with the given positions, and returns once every grain is done.
+    // Returns false without rendering anything if there are no workers to help, the block
+    // is too long, or the pool is stopped or stopping, so the caller renders the grains itself.
+    bool render(int numGrains, float* const* dest, int numChannels, int numSamples,
+                RenderFunction renderFunction, void* context, GrainKernels::GrainPositions& positions);
+
+private:
+    struct Worker
+    {
+        std::thread thread;
+        std::vector<float> accumulator; // numChannels runs of maxBlockSize samples
+        GrainKernels::GrainPositions positions;
+        std::atomic<unsigned int> outputGeneration { 1 }; // The last block this worker rendered any grains for
+    };
+
+    void runWorker(Worker& worker);
+    void runJobs(float* const* dest, GrainKernels::GrainPositions& positions, Worker* worker);
+
+    static constexpr int grainsPerJob = 4;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    int maxBlockSize { 0 };
+
+    // The current block, written by the audio thread before it bumps the generation
+    int numGrains { 0 };
+    int numJobs { 0 };
+    int numChannels { 0 };
+    int numSamples { 0 };
+    RenderFunction renderFunction { nullptr };
+    void* context { nullptr };
+
+    // Odd while the audio thread is writing a new block, even once it's published
+    std::atomic<unsigned int> generation { 0 };
+    std::atomic<int> nextJob { 0 };
+    std::atomic<int> numJobsDone { 0 };
+    std::atomic<int> numActiveWorkers { 0 };
+    std::atomic<bool> shouldExit { false };
+
+    // stop() clears running and then waits for rendering to go false, while render() sets
+    // rendering and then checks running, so one of them always sees the other
+    std::atomic<bool> running { false };
+    std::atomic<bool> rendering { false };
+};
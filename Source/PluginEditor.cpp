@@ -132,6 +132,219 @@ juce::String CustomRotarySlider::getDisplayString() const
 }
 
 
+//==============================================================================
+WaveformDisplay::WaveformDisplay(WaveformFeed& feed)
+    : waveformFeed(feed), incoming(static_cast<size_t>(WaveformFeed::fifoSize))
+{
+    // Throw away anything left over from the last time an editor was open
+    while (waveformFeed.pull(incoming.data(), WaveformFeed::fifoSize) > 0) {}
+
+    waveformFeed.setActive(true);
+    startTimerHz(30);
+}
+
+WaveformDisplay::~WaveformDisplay()
+{
+    waveformFeed.setActive(false);
+}
+
+void WaveformDisplay::resized()
+{
+    // Ask for exactly one peak per pixel column
+    history.assign(static_cast<size_t>(juce::jmax(1, getWidth())), {});
+    oldestPeak = 0;
+    waveformFeed.setNumPeaks(getWidth());
+}
+
+void WaveformDisplay::timerCallback()
+{
+    auto numPulled = waveformFeed.pull(incoming.data(), WaveformFeed::fifoSize);
+
+    if (numPulled == 0)
+        return;
+
+    for (int i = 0; i < numPulled; ++i)
+    {
+        history[oldestPeak] = incoming[static_cast<size_t>(i)];
+        oldestPeak = (oldestPeak + 1) % history.size();
+    }
+
+    repaint();
+}
+
+void WaveformDisplay::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colours::black);
+    g.setColour(juce::Colour(70u, 75u, 80u));
+
+    auto halfHeight = getHeight() * 0.5f;
+
+    for (size_t x = 0; x < history.size(); ++x)
+    {
+        auto& peak = history[(oldestPeak + x) % history.size()];
+        auto top = halfHeight - juce::jlimit(-1.f, 1.f, peak.max) * halfHeight;
+        auto bottom = halfHeight - juce::jlimit(-1.f, 1.f, peak.min) * halfHeight;
+
+        g.drawVerticalLine(static_cast<int>(x), top, juce::jmax(bottom, top + 1.f));
+    }
+}
+
+//==============================================================================
+namespace
+{
+    // Drop grains that have gone quiet for this long, in case their end event was dropped
+    constexpr double grainTimeoutMs = 250.0;
+
+    // Dot alpha is quantised so a grain with a steady envelope isn't redrawn every frame
+    constexpr int numAlphaSteps = 16;
+}
+
+GrainCloudDisplay::GrainCloudDisplay(GrainTelemetry& telemetry)
+    : grainTelemetry(telemetry), incoming(static_cast<size_t>(GrainTelemetry::fifoSize))
+{
+    setInterceptsMouseClicks(false, false);
+
+    // Throw away anything left over from the last time an editor was open
+    while (grainTelemetry.pull(incoming.data(), GrainTelemetry::fifoSize) > 0) {}
+
+    grainTelemetry.setActive(true);
+    startTimerHz(30);
+}
+
+GrainCloudDisplay::~GrainCloudDisplay()
+{
+    grainTelemetry.setActive(false);
+}
+
+void GrainCloudDisplay::resized()
+{
+    layer = juce::Image(juce::Image::ARGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), true);
+
+    // Everything has to be drawn again at the new size
+    for (auto& grain : grains)
+        grain.drawnBounds = {};
+
+    repaint();
+}
+
+void GrainCloudDisplay::applyEvent(const GrainTelemetry::Event& event, double now)
+{
+    auto slot = static_cast<size_t>(event.slot);
+
+    if (slot >= grains.size())
+        grains.resize(slot + 1);
+
+    auto& grain = grains[slot];
+
+    if (event.type == GrainTelemetry::Event::Type::end)
+    {
+        grain.live = false;
+        return;
+    }
+
+    // Playhead updates carry everything a spawn does, so a dropped spawn only delays the dot
+    grain.live = true;
+    grain.delayMs = event.delayMs;
+    grain.sizeMs = event.sizeMs;
+    grain.speed = event.speed;
+    grain.gain = event.gain;
+    grain.lastUpdateMs = now;
+}
+
+juce::Rectangle<int> GrainCloudDisplay::getGrainBounds(const GrainView& grain) const
+{
+    if (!grain.live)
+        return {};
+
+    // Same mapping as the RangeVisualiser, with the newest audio on the right
+    auto x = (1.f - juce::jmap(grain.delayMs, 0.f, 5000.f, 0.f, 1.f)) * getWidth();
+
+    // Pitch goes from 0.25x to 4x before detune, so this leaves a little room at each end
+    auto octaves = std::log2(juce::jmax(grain.speed, 0.01f));
+    auto y = juce::jmap(juce::jlimit(-2.5f, 2.5f, octaves), -2.5f, 2.5f, getHeight() - 4.f, 4.f);
+
+    // Longer grains get bigger dots
+    auto diameter = juce::jmap(grain.sizeMs, 1.f, 100.f, 3.f, 8.f);
+
+    return juce::Rectangle<float>(diameter, diameter).withCentre({ x, y }).getSmallestIntegerContainer();
+}
+
+// Follows the grain's window as the engine applies it, so dots fade in and out with the sound
+int GrainCloudDisplay::getGrainAlpha(const GrainView& grain)
+{
+    if (!grain.live)
+        return 0;
+
+    return juce::jlimit(1, numAlphaSteps, juce::roundToInt(grain.gain * numAlphaSteps));
+}
+
+void GrainCloudDisplay::timerCallback()
+{
+    auto now = juce::Time::getMillisecondCounterHiRes();
+    auto numEvents = grainTelemetry.pull(incoming.data(), GrainTelemetry::fifoSize);
+
+    for (int i = 0; i < numEvents; ++i)
+        applyEvent(incoming[static_cast<size_t>(i)], now);
+
+    // Collect the areas where a dot appeared, moved, faded or went away
+    juce::RectangleList<int> dirtyRegion;
+
+    for (auto& grain : grains)
+    {
+        if (grain.live && now - grain.lastUpdateMs > grainTimeoutMs)
+            grain.live = false;
+
+        auto bounds = getGrainBounds(grain);
+        auto alpha = getGrainAlpha(grain);
+
+        if (bounds == grain.drawnBounds && alpha == grain.drawnAlpha)
+            continue;
+
+        dirtyRegion.add(grain.drawnBounds);
+        dirtyRegion.add(bounds);
+        grain.drawnBounds = bounds;
+        grain.drawnAlpha = alpha;
+    }
+
+    if (dirtyRegion.isEmpty())
+        return;
+
+    dirtyRegion.consolidate();
+    redrawLayer(dirtyRegion);
+
+    for (auto& area : dirtyRegion)
+        repaint(area);
+}
+
+// Clears the dirty areas of the layer and draws back in every dot that overlaps them
+void GrainCloudDisplay::redrawLayer(const juce::RectangleList<int>& dirtyRegion)
+{
+    juce::Graphics g(layer);
+
+    for (auto& area : dirtyRegion)
+    {
+        layer.clear(area);
+
+        juce::Graphics::ScopedSaveState state(g);
+        g.reduceClipRegion(area);
+
+        for (auto& grain : grains)
+        {
+            if (!grain.live || !grain.drawnBounds.intersects(area))
+                continue;
+
+            g.setColour(juce::Colours::white.withAlpha(grain.drawnAlpha / static_cast<float>(numAlphaSteps)));
+            g.fillEllipse(grain.drawnBounds.toFloat());
+        }
+    }
+}
+
+void GrainCloudDisplay::paint(juce::Graphics& g)
+{
+    // Only the repainted areas actually get drawn, since JUCE clips to them
+    g.drawImageAt(layer, 0, 0);
+}
+
 //==============================================================================
 void RangeVisualiser::paint(juce::Graphics &g)
 {
@@ -156,8 +369,10 @@ void RangeVisualiser::paint(juce::Graphics &g)
 // Editor constructor!
 GranularDelayAudioProcessorEditor::GranularDelayAudioProcessorEditor (GranularDelayAudioProcessor& p)
     : AudioProcessorEditor (&p), processorRef (p), 
+    waveformDisplay(processorRef.getWaveformFeed()),
     rangeVisualizer(*processorRef.apvts.getRawParameterValue("rangeStart"),
                     *processorRef.apvts.getRawParameterValue("rangeEnd")),
+    grainCloudDisplay(processorRef.getGrainTelemetry()),
 
     inputGainSlider(*processorRef.apvts.getParameter("inputGain"), "%"),
     mixSlider(*processorRef.apvts.getParameter("mix"), "%"),
@@ -166,9 +381,12 @@ GranularDelayAudioProcessorEditor::GranularDelayAudioProcessorEditor (GranularDe
     rangeStartSlider(*processorRef.apvts.getParameter("rangeStart"), "ms"),
     rangeEndSlider(*processorRef.apvts.getParameter("rangeEnd"), "ms"),
     pitchSlider(*processorRef.apvts.getParameter("grainPitch"), "x"),
-    dummy2Slider(*processorRef.apvts.getParameter("dummy2"), ""),
+    spreadSlider(*processorRef.apvts.getParameter("spread"), "%"),
     detuneSlider(*processorRef.apvts.getParameter("detune"), "c"),
-    dummy4Slider(*processorRef.apvts.getParameter("dummy4"), ""),
+    feedbackSlider(*processorRef.apvts.getParameter("feedback"), "%"),
+    swingSlider(*processorRef.apvts.getParameter("swing"), "%"),
+    probabilitySlider(*processorRef.apvts.getParameter("probability"), "%"),
+    overlapSlider(*processorRef.apvts.getParameter("overlap"), "x"),
 
     inputGainSliderAttachment(processorRef.apvts, "inputGain", inputGainSlider),
     mixSliderAttachment(processorRef.apvts, "mix", mixSlider),
@@ -177,9 +395,15 @@ GranularDelayAudioProcessorEditor::GranularDelayAudioProcessorEditor (GranularDe
     rangeStartSliderAttachment(processorRef.apvts, "rangeStart", rangeStartSlider),
     rangeEndSliderAttachment(processorRef.apvts, "rangeEnd", rangeEndSlider),
     pitchSliderAttachment(processorRef.apvts, "grainPitch", pitchSlider),
-    dummy2SliderAttachment(processorRef.apvts, "dummy2", dummy2Slider),
+    spreadSliderAttachment(processorRef.apvts, "spread", spreadSlider),
     detuneSliderAttachment(processorRef.apvts, "detune", detuneSlider),
-    dummy4SliderAttachment(processorRef.apvts, "dummy4", dummy4Slider)
+    feedbackSliderAttachment(processorRef.apvts, "feedback", feedbackSlider),
+    swingSliderAttachment(processorRef.apvts, "swing", swingSlider),
+    probabilitySliderAttachment(processorRef.apvts, "probability", probabilitySlider),
+    overlapSliderAttachment(processorRef.apvts, "overlap", overlapSlider),
+    sincRenderOnlyButtonAttachment(processorRef.apvts, "sincRenderOnly", sincRenderOnlyButton),
+    rangeSyncButtonAttachment(processorRef.apvts, "rangeSync", rangeSyncButton),
+    normaliseDensityButtonAttachment(processorRef.apvts, "normaliseDensity", normaliseDensityButton)
 {
     processorRef.apvts.addParameterListener("rangeStart", this);
     processorRef.apvts.addParameterListener("rangeEnd", this);
@@ -215,6 +439,31 @@ GranularDelayAudioProcessorEditor::GranularDelayAudioProcessorEditor (GranularDe
             rangeEndSlider.setValue(rangeStart);
     };
 
+    // Fill in the interpolation choices before attaching the combo box
+    if (auto* interpolationParam = dynamic_cast<juce::AudioParameterChoice*>(processorRef.apvts.getParameter("interpolation")))
+        interpolationBox.addItemList(interpolationParam->choices, 1);
+
+    interpolationBoxAttachment = std::make_unique<ComboBoxAttachment>(processorRef.apvts, "interpolation", interpolationBox);
+
+    if (auto* grainWindowParam = dynamic_cast<juce::AudioParameterChoice*>(processorRef.apvts.getParameter("grainWindow")))
+        grainWindowBox.addItemList(grainWindowParam->choices, 1);
+
+    grainWindowBoxAttachment = std::make_unique<ComboBoxAttachment>(processorRef.apvts, "grainWindow", grainWindowBox);
+
+    if (auto* grainTimingParam = dynamic_cast<juce::AudioParameterChoice*>(processorRef.apvts.getParameter("grainTiming")))
+        grainTimingBox.addItemList(grainTimingParam->choices, 1);
+
+    grainTimingBoxAttachment = std::make_unique<ComboBoxAttachment>(processorRef.apvts, "grainTiming", grainTimingBox);
+
+    if (auto* syncRateParam = dynamic_cast<juce::AudioParameterChoice*>(processorRef.apvts.getParameter("syncRate")))
+        syncRateBox.addItemList(syncRateParam->choices, 1);
+
+    syncRateBoxAttachment = std::make_unique<ComboBoxAttachment>(processorRef.apvts, "syncRate", syncRateBox);
+
+    sincRenderOnlyButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    rangeSyncButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    normaliseDensityButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+
 
     // Make all components visible
     for(auto* comp : getComps())
@@ -223,7 +472,7 @@ GranularDelayAudioProcessorEditor::GranularDelayAudioProcessorEditor (GranularDe
     }
 
     // Set the size of the editor
-    setSize (620, 420);
+    setSize (700, 460);
 }
 
 GranularDelayAudioProcessorEditor::~GranularDelayAudioProcessorEditor()
@@ -261,9 +510,6 @@ void GranularDelayAudioProcessorEditor::paint (juce::Graphics& g)
     title.setJustificationType(juce::Justification::centred);
     title.setColour(juce::Label::textColourId, juce::Colours::white);
 
-    // Paint the waveViewer
-    processorRef.waveViewer.setColours(juce::Colours::black, juce::Colour(70u, 75u, 80u));
-
     // Paint boxes around all components (for testing)
     // g.setColour(juce::Colours::yellow);
     // for (const auto& comp : getComps())
@@ -281,36 +527,60 @@ void GranularDelayAudioProcessorEditor::resized()
     bounds.reduce(10, 10);
 
     auto titleZone = bounds.withTrimmedBottom(static_cast<int>(bounds.getHeight() * 0.9f) + 10);
+
+    // The quarters either side of the title hold the engine options
+    auto leftOptionZone = titleZone.withTrimmedRight(static_cast<int>(titleZone.getWidth() * 0.75f));
+    auto rightOptionZone = titleZone.withTrimmedLeft(static_cast<int>(titleZone.getWidth() * 0.75f));
+    auto grainWindowZone = rightOptionZone.removeFromLeft(rightOptionZone.getWidth() / 2);
     
     auto waveViewerZone = bounds.withTrimmedTop(static_cast<int>(bounds.getHeight() * 0.1f))
                                 .withTrimmedBottom(static_cast<int>(bounds.getHeight() * 0.6f));
 
-    auto sliderZone = bounds.withTrimmedTop(static_cast<int>(bounds.getHeight() * 0.4f));
+    // A strip under the waveform holds the grain timing options
+    auto timingZone = bounds.withTrimmedTop(static_cast<int>(bounds.getHeight() * 0.4f))
+                            .withTrimmedBottom(static_cast<int>(bounds.getHeight() * 0.52f));
+    auto grainTimingZone = timingZone.removeFromLeft(timingZone.getWidth() / 4);
+    auto syncRateZone = timingZone.removeFromLeft(timingZone.getWidth() / 3);
+    auto rangeSyncZone = timingZone.removeFromLeft(timingZone.getWidth() / 2);
+
+    auto sliderZone = bounds.withTrimmedTop(static_cast<int>(bounds.getHeight() * 0.48f));
 
     std::vector<juce::Rectangle<int>> sliderBoxes;
     
     auto topRow = sliderZone.withTrimmedBottom(static_cast<int>(sliderZone.getHeight() * 0.5f));
     auto bottomRow = sliderZone.withTrimmedTop(static_cast<int>(sliderZone.getHeight() * 0.5f));
-    
-    for (int i = 0; i < 4; ++i)
+
+    // The sliders are split evenly between the two rows
+    auto sliders = getSliders();
+    auto numColumns = static_cast<int>((sliders.size() + 1) / 2);
+    auto columnFraction = 1.f / static_cast<float>(numColumns);
+
+    for (int i = 0; i < numColumns; ++i)
     {
-        sliderBoxes.push_back(topRow.withTrimmedLeft(static_cast<int>(topRow.getWidth() * 0.25f * i))
-                                    .withTrimmedRight(static_cast<int>(topRow.getWidth() * 0.25f * (3 - i))));
+        sliderBoxes.push_back(topRow.withTrimmedLeft(static_cast<int>(topRow.getWidth() * columnFraction * i))
+                                    .withTrimmedRight(static_cast<int>(topRow.getWidth() * columnFraction * (numColumns - 1 - i))));
     }
 
-    for (int i = 0; i < 4; ++i)
+    for (int i = 0; i < numColumns; ++i)
     {
-        sliderBoxes.push_back(bottomRow.withTrimmedLeft(static_cast<int>(bottomRow.getWidth() * 0.25f * i))
-                                       .withTrimmedRight(static_cast<int>(bottomRow.getWidth() * 0.25f * (3 - i))));
+        sliderBoxes.push_back(bottomRow.withTrimmedLeft(static_cast<int>(bottomRow.getWidth() * columnFraction * i))
+                                       .withTrimmedRight(static_cast<int>(bottomRow.getWidth() * columnFraction * (numColumns - 1 - i))));
     }
 
     // Set the bounds of the components
     title.setBounds(titleZone);
-    processorRef.waveViewer.setBounds(waveViewerZone);
+    sincRenderOnlyButton.setBounds(leftOptionZone);
+    interpolationBox.setBounds(rightOptionZone.reduced(0, 4));
+    grainWindowBox.setBounds(grainWindowZone.reduced(2, 4));
+    grainTimingBox.setBounds(grainTimingZone.reduced(2, 4));
+    syncRateBox.setBounds(syncRateZone.reduced(2, 4));
+    rangeSyncButton.setBounds(rangeSyncZone.reduced(2, 0));
+    normaliseDensityButton.setBounds(timingZone.reduced(2, 0));
+    waveformDisplay.setBounds(waveViewerZone);
     rangeVisualizer.setBounds(waveViewerZone);
+    grainCloudDisplay.setBounds(waveViewerZone);
 
-    auto sliders = getSliders();
-    for(size_t i = 0; i < sliderBoxes.size(); ++i)
+    for(size_t i = 0; i < sliders.size(); ++i)
     {
         sliders[i]->setBounds(sliderBoxes[i]);
     }
@@ -320,8 +590,9 @@ void GranularDelayAudioProcessorEditor::resized()
 std::vector<juce::Component*> GranularDelayAudioProcessorEditor::getComps()
 {
     return {&title,
-            &processorRef.waveViewer,
+            &waveformDisplay,
             &rangeVisualizer,
+            &grainCloudDisplay,
             &inputGainSlider,
             &frequencySlider,
             &grainSizeSlider,
@@ -329,9 +600,19 @@ std::vector<juce::Component*> GranularDelayAudioProcessorEditor::getComps()
             &rangeStartSlider,
             &rangeEndSlider,
             &pitchSlider,
-            &dummy2Slider,
+            &spreadSlider,
             &detuneSlider,
-            &dummy4Slider
+            &feedbackSlider,
+            &swingSlider,
+            &probabilitySlider,
+            &overlapSlider,
+            &interpolationBox,
+            &grainWindowBox,
+            &grainTimingBox,
+            &syncRateBox,
+            &sincRenderOnlyButton,
+            &rangeSyncButton,
+            &normaliseDensityButton
             };
 }
 
@@ -342,11 +623,14 @@ std::vector<juce::Component*> GranularDelayAudioProcessorEditor::getSliders()
             &rangeStartSlider,
             &grainSizeSlider,
             &pitchSlider,
+            &spreadSlider,
+            &swingSlider,
+            &overlapSlider,
             &mixSlider,
             &rangeEndSlider,
             &frequencySlider,
             &detuneSlider,
-            &dummy2Slider,
-            &dummy4Slider
+            &feedbackSlider,
+            &probabilitySlider
             };
 }
\ No newline at end of file
@@ -46,6 +46,70 @@ private:
     juce::String suffix;
 };
 
+//==============================================================================
+// Draws the last few seconds of input, newest on the right, one min/max peak per pixel
+// column. The peaks come from the processor's WaveformFeed, which is drained on a timer.
+class WaveformDisplay : public juce::Component,
+                        private juce::Timer
+{
+public:
+    explicit WaveformDisplay(WaveformFeed& feed);
+    ~WaveformDisplay() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    void timerCallback() override;
+
+    WaveformFeed& waveformFeed;
+    std::vector<WaveformFeed::Peak> history; // One peak per pixel column, used as a ring
+    std::vector<WaveformFeed::Peak> incoming;
+    size_t oldestPeak { 0 };
+};
+
+//==============================================================================
+// Draws a dot for every live grain over the RangeVisualiser: across by how far behind
+// the input it is reading, up by its playback speed, and faded by its envelope. The
+// dots live in a cached image layer, and each frame only the areas where a dot moved
+// or changed are redrawn into the layer and repainted.
+class GrainCloudDisplay : public juce::Component,
+                          private juce::Timer
+{
+public:
+    explicit GrainCloudDisplay(GrainTelemetry& telemetry);
+    ~GrainCloudDisplay() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    struct GrainView
+    {
+        bool live = false;
+        float delayMs = 0.f;
+        float sizeMs = 0.f;
+        float speed = 1.f;
+        float gain = 0.f;
+        double lastUpdateMs = 0.0;
+
+        // Where and how brightly the grain is currently drawn in the layer
+        juce::Rectangle<int> drawnBounds;
+        int drawnAlpha = 0;
+    };
+
+    void timerCallback() override;
+    void applyEvent(const GrainTelemetry::Event& event, double now);
+    juce::Rectangle<int> getGrainBounds(const GrainView& grain) const;
+    static int getGrainAlpha(const GrainView& grain);
+    void redrawLayer(const juce::RectangleList<int>& dirtyRegion);
+
+    GrainTelemetry& grainTelemetry;
+    std::vector<GrainTelemetry::Event> incoming;
+    std::vector<GrainView> grains; // Indexed by GrainPool slot
+    juce::Image layer;
+};
+
 //==============================================================================
 class RangeVisualiser : public juce::Component
 {
@@ -83,7 +147,9 @@ private:
     GranularDelayAudioProcessor& processorRef;
 
     juce::Label title;
+    WaveformDisplay waveformDisplay;
     RangeVisualiser rangeVisualizer;
+    GrainCloudDisplay grainCloudDisplay;
 
     // Create sliders
     CustomRotarySlider inputGainSlider,
@@ -93,9 +159,20 @@ private:
                        rangeStartSlider,
                        rangeEndSlider,
                        pitchSlider,
-                       dummy2Slider,
+                       spreadSlider,
                        detuneSlider,
-                       dummy4Slider;
+                       feedbackSlider,
+                       swingSlider,
+                       probabilitySlider,
+                       overlapSlider;
+
+    juce::ComboBox interpolationBox;
+    juce::ComboBox grainWindowBox;
+    juce::ComboBox grainTimingBox;
+    juce::ComboBox syncRateBox;
+    juce::ToggleButton sincRenderOnlyButton { "Sinc only when rendering" };
+    juce::ToggleButton rangeSyncButton { "Snap range to tempo" };
+    juce::ToggleButton normaliseDensityButton { "Normalise density" };
 
     // Function to get a vector of all components
     std::vector<juce::Component*> getComps();
@@ -106,6 +183,8 @@ private:
     // Type aliasing for readability
     using APVTS = juce::AudioProcessorValueTreeState;
     using Attachment = APVTS::SliderAttachment;
+    using ComboBoxAttachment = APVTS::ComboBoxAttachment;
+    using ButtonAttachment = APVTS::ButtonAttachment;
 
     // Create control Attachments 
     Attachment inputGainSliderAttachment,
@@ -115,9 +194,21 @@ private:
                rangeStartSliderAttachment,
                rangeEndSliderAttachment,
                pitchSliderAttachment,
-               dummy2SliderAttachment,
+               spreadSliderAttachment,
                detuneSliderAttachment,
-               dummy4SliderAttachment;
+               feedbackSliderAttachment,
+               swingSliderAttachment,
+               probabilitySliderAttachment,
+               overlapSliderAttachment;
+
+    // The combo boxes have to be filled in before they are attached, so these are made in the constructor
+    std::unique_ptr<ComboBoxAttachment> interpolationBoxAttachment;
+    std::unique_ptr<ComboBoxAttachment> grainWindowBoxAttachment;
+    std::unique_ptr<ComboBoxAttachment> grainTimingBoxAttachment;
+    std::unique_ptr<ComboBoxAttachment> syncRateBoxAttachment;
+    ButtonAttachment sincRenderOnlyButtonAttachment,
+                     rangeSyncButtonAttachment,
+                     normaliseDensityButtonAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GranularDelayAudioProcessorEditor)
 };
@@ -1,5 +1,6 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "RealtimeCheck.h"
 
 //==============================================================================
 GranularDelayAudioProcessor::GranularDelayAudioProcessor()
@@ -7,12 +8,24 @@ GranularDelayAudioProcessor::GranularDelayAudioProcessor()
                       .withInput  ("Input",  juce::AudioChannelSet::stereo())
                       .withOutput ("Output", juce::AudioChannelSet::stereo())),
                       apvts(*this, nullptr, "Parameters", createParameterLayout()),
-                      waveViewer(1), timer([this]() { timerCallback(); })
+                      chainParameters(apvts)
 {
+    maxRangeEndMs = apvts.getParameterRange("rangeEnd").end;
+    rangeEndLimitMs = maxRangeEndMs;
+
+    // Every new instance sounds different, until a saved state brings back its own seed
+    setRandomSeed(juce::Random::getSystemRandom().nextInt64());
+
+    apvts.addParameterListener("multithreaded", this);
 }
 
 GranularDelayAudioProcessor::~GranularDelayAudioProcessor()
 {
+    apvts.removeParameterListener("multithreaded", this);
+    grainWorkerPool.stop();
+
+    delete pendingDelayBuffer.exchange(nullptr);
+    delete retiredDelayBuffer.exchange(nullptr);
 }
 
 //==============================================================================
@@ -48,9 +61,19 @@ bool GranularDelayAudioProcessor::isMidiEffect() const
    #endif
 }
 
+// Grains keep reading the delayBuffer after the input stops, so the tail is as long as
+// the furthest they can reach with the current settings
 double GranularDelayAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    auto chainSettings = chainParameters.load();
+    auto tailSeconds = getReachMs(chainSettings) / 1000.0;
+
+    // Roughly, each pass round the feedback loop comes back quieter by the feedback gain,
+    // so allow for as many passes as it takes to fall by 60 dB
+    if (chainSettings.feedback > 0.f)
+        tailSeconds *= 1.0 + std::ceil(std::log(0.001) / std::log(static_cast<double>(chainSettings.feedback)));
+
+    return tailSeconds;
 }
 
 int GranularDelayAudioProcessor::getNumPrograms()
@@ -85,21 +108,118 @@ void GranularDelayAudioProcessor::prepareToPlay (double sampleRate, int samplesP
 {
     juce::ignoreUnused (sampleRate, samplesPerBlock);
 
-    auto delayBufferSize = static_cast<int>(sampleRate * 10);
-    delayBuffer.setSize(getTotalNumOutputChannels(), delayBufferSize);
-    wetBuffer.setSize(getTotalNumInputChannels(), samplesPerBlock);
+    // Grains read straight from the delayBuffer, so it has to hold everything a grain
+    // might still need by the time the write position catches up with it
+    auto delayBufferSize = getDelayBufferSize(getMaxReadDistance(sampleRate, maxRangeEndMs));
+    delete pendingDelayBuffer.exchange(nullptr);
+    delete retiredDelayBuffer.exchange(nullptr);
+    requestedDelayBufferSize = delayBufferSize;
+    rangeEndLimitMs = maxRangeEndMs;
+
+    delayBuffer.setSize(delayBufferSize);
+    wetBuffer.setSize(getTotalNumInputChannels(), subBlockSize);
+    feedbackPath.prepare(sampleRate, getTotalNumInputChannels(), subBlockSize);
+
+    // One channel of ramp per smoothed parameter
+    rampBuffer.setSize(2, subBlockSize);
+
+    inputGainSmoother.reset(sampleRate, 0.05);
+    mixSmoother.reset(sampleRate, 0.05);
+
+    // Allocate every grain and build every lookup table up front so processBlock never has to
+    grainPool.prepare(getMaxNumGrains());
+    sincTables.build();
+    windowTables.build();
+    panTable.build();
 
-    waveViewer.setSamplesPerBlock(delayBufferSize / 2 / 1024);
+    // The worker threads only run while the multithreaded parameter is on
+    updateGrainWorkers(getTotalNumInputChannels());
 
-    timer.startTimer(timerInterval);
+    waveformFeed.prepare(sampleRate);
+    grainTelemetry.prepare(sampleRate);
 
-    DBG("Plugin set up!");
+    reset();
+}
+
+// Clears the delay line and every grain without reallocating anything, so the next block
+// starts from silence with the random sequence back at the start of the seed. Offline
+// renders can call this between files instead of preparing again.
+void GranularDelayAudioProcessor::reset()
+{
+    delayBuffer.clear();
+    grainPool.clear();
+    writePosition = 0;
+    grainPhase = 0.0;
+    samplesUntilPoissonGrain = 0.0;
+    poissonRate = 0.0;
+    syncPosition = 0.0;
+    syncStepLength = 0.0;
+    samplesOfSilence = delayBuffer.getCapacity();
+    grainRandom.setSeed(static_cast<uint64_t>(getRandomSeed()));
+
+    auto chainSettings = chainParameters.load();
+    inputGainSmoother.setCurrentAndTargetValue(chainSettings.inputGain);
+    mixSmoother.setCurrentAndTargetValue(chainSettings.mix);
+    feedbackPath.reset(chainSettings.feedback);
 }
 
 void GranularDelayAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    updateGrainWorkers(0);
+}
+
+//==============================================================================
+// Idle workers still wake up now and then, so the grainWorkerPool is only kept running
+// while the multithreaded parameter is on. Starting and stopping it has to happen off the
+// audio thread, so if the host changes the parameter from there it's left to the message thread.
+void GranularDelayAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    juce::ignoreUnused(parameterID, newValue);
+
+    if (juce::MessageManager::existsAndIsCurrentThread())
+    {
+        cancelPendingUpdate();
+        handleAsyncUpdate();
+    }
+    else
+    {
+        triggerAsyncUpdate();
+    }
+}
+
+void GranularDelayAudioProcessor::handleAsyncUpdate()
+{
+    int numChannels = 0;
+
+    {
+        const std::lock_guard<std::mutex> lock(grainWorkerLock);
+        numChannels = grainWorkerChannels;
+    }
+
+    updateGrainWorkers(numChannels);
+}
+
+// Starts or stops the grainWorkerPool to match the multithreaded parameter, for blocks of
+// numChannels channels (0 stops it whatever the parameter says). Must not be called on the
+// audio thread, which just renders every grain itself while the pool isn't running.
+void GranularDelayAudioProcessor::updateGrainWorkers(int numChannels)
+{
+    const std::lock_guard<std::mutex> lock(grainWorkerLock);
+
+    if (numChannels != grainWorkerChannels)
+    {
+        grainWorkerPool.stop();
+        grainWorkerChannels = numChannels;
+    }
+
+    bool shouldRun = numChannels > 0 && chainParameters.load().multithreaded;
+
+    if (shouldRun && !grainWorkerPool.isRunning())
+        grainWorkerPool.start(GrainWorkerPool::getDefaultNumWorkers(), numChannels, subBlockSize);
+    else if (!shouldRun && grainWorkerPool.isRunning())
+        grainWorkerPool.stop();
 }
 
 bool GranularDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -129,214 +249,637 @@ bool GranularDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& lay
 void GranularDelayAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                                 juce::MidiBuffer& midiMessages)
 {
-    DBG("Processing a block!");
     juce::ignoreUnused(midiMessages);
 
+   #if GRANULAR_DELAY_REALTIME_CHECKS
+    RealtimeCheck::ScopedRealtimeSection realtimeSection;
+   #endif
+
     juce::ScopedNoDenormals noDenormals;
 
+    if (pendingDelayBuffer.load(std::memory_order_relaxed) != nullptr
+        && retiredDelayBuffer.load(std::memory_order_acquire) == nullptr)
+        swapInPendingDelayBuffer();
+
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
-    auto blockSize = buffer.getNumSamples();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    // Get parameter values
-    auto chainSettings = getChainSettings(apvts);
-    float inputGain = chainSettings.inputGain;
-    float mix = chainSettings.mix;
-    float frequency = chainSettings.frequency;
+    readHostPosition();
 
-    int interval = static_cast<int>(1000 / frequency);
-    timerInterval = interval;
-
-    if (grainRequested.load())
+    // Hosts can send any number of samples, whatever they announced in prepareToPlay, so
+    // the engine only ever sees sub-blocks. Each one refers to the host's channel data.
+    for (int start = 0; start < buffer.getNumSamples(); start += subBlockSize)
     {
-        addGrain();
-        grainRequested.store(false);
+        auto numSamples = juce::jmin(subBlockSize, buffer.getNumSamples() - start);
+        juce::AudioBuffer<float> subBlock(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, numSamples);
+
+        processSubBlock(subBlock);
     }
+}
+
+// Runs the whole engine on up to subBlockSize samples
+void GranularDelayAudioProcessor::processSubBlock(juce::AudioBuffer<float>& buffer)
+{
+    auto totalNumInputChannels = getTotalNumInputChannels();
+    auto blockSize = buffer.getNumSamples();
+    jassert(blockSize <= subBlockSize);
+
+    // Take one snapshot of the parameter values for the whole sub-block
+    auto chainSettings = chainParameters.load();
+
+    if (chainSettings.rangeSync)
+        snapRangeToTempo(chainSettings);
+
+    wetBuffer.clear(0, blockSize);
+    applyInputGain(buffer, chainSettings.inputGain);
 
-    wetBuffer.clear();
-    buffer.applyGain(inputGain);
+    // With no grains playing and nothing but silence within their reach, new grains would
+    // only read silence, so skip the grain machinery until there's something to hear
+    bool reachIsSilent = updateSilence(buffer, chainSettings);
 
-    // Give the buffer to the wave viewer 
-    waveViewer.pushBuffer(buffer);
+    if (!reachIsSilent || !grainPool.empty())
+        scheduleGrains(chainSettings, blockSize);
 
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
-    {        
-        // Copy the input buffer into the delayBuffer
+    // Give the buffer to the editor's waveform display (does nothing if it isn't open)
+    waveformFeed.push(buffer);
+
+    // Copy the input buffer into the delayBuffer
+    for (int channel = 0; channel < juce::jmin(totalNumInputChannels, DelayBuffer::numChannels); ++channel)
         fillDelayBuffer(buffer, channel, 1.f);
 
-        // Read from the grains into the wetBuffer
-        if (!grainVector.empty())
-            readGrains(wetBuffer, channel);
-        
-        // Mix grains with dry signal 
-        buffer.applyGain(channel, 0, blockSize, 1.f - mix);
-        buffer.addFrom(channel, 0, wetBuffer, channel, 0, blockSize, mix);
-    }
+    // Read from the grains into the wetBuffer (every channel in one pass)
+    if (!grainPool.empty())
+        readGrains(blockSize, chainSettings.multithreaded);
+
+    // This has to come before the mix, which uses the wetBuffer as scratch space
+    if (feedbackPath.isActive(chainSettings.feedback))
+        feedBackGrains(blockSize, chainSettings.feedback);
 
-    if (!grainVector.empty())
-        cleanUpGrains();
+    // Mix grains with dry signal 
+    mixWetWithDry(buffer, chainSettings.mix);
+
+    if (grainTelemetry.isActive())
+        publishGrainTelemetry(blockSize);
 
     updateWritePosition(blockSize);
+    syncPosition += blockSize * getQuarterNotesPerSample();
 }
 
-// Copies one channel of a buffer to the delayBuffer at the writePosition (with wraparound)
-void GranularDelayAudioProcessor::fillDelayBuffer(juce::AudioBuffer<float>& buffer, int channel, float gain)
-{   
-    auto bufferSize = buffer.getNumSamples();
-    auto delayBufferSize = delayBuffer.getNumSamples();
-    // DBG("bufferSize = " << bufferSize);
+// Counts how long everything written to the delayBuffer has been below silenceThreshold
+// (feedBackGrains() restarts the count when it writes anything louder), and returns true
+// if grains spawned with these settings could only read samples from that silence
+bool GranularDelayAudioProcessor::updateSilence(const juce::AudioBuffer<float>& buffer, const ChainSettings& chainSettings)
+{
+    auto blockSize = buffer.getNumSamples();
+    bool inputIsSilent = true;
+
+    for (int channel = 0; channel < juce::jmin(getTotalNumInputChannels(), DelayBuffer::numChannels); ++channel)
+        inputIsSilent = inputIsSilent && buffer.getMagnitude(channel, 0, blockSize) < silenceThreshold;
+
+    // Anything older than the whole delayBuffer has been overwritten, so there's no need to count further
+    samplesOfSilence = inputIsSilent ? juce::jmin(samplesOfSilence + blockSize, delayBuffer.getCapacity()) : 0;
+
+    auto reachSamples = getReachMs(chainSettings) * getSampleRate() / 1000.0 + GrainKernels::SincTable::numTaps;
+    return samplesOfSilence > reachSamples;
+}
+
+// Returns how far behind the write position grains spawned with these settings can read.
+// A grain starts at most rangeEnd back (or its own size back, if that's further), and a
+// grain slower than the input falls further behind while it plays: it reads grainSize of
+// input over grainSize / speed, so it ends grainSize * (1 / speed - 1) further back.
+float GranularDelayAudioProcessor::getReachMs(const ChainSettings& chainSettings)
+{
+    auto slowestSpeed = chainSettings.grainPitch / std::pow(2.f, chainSettings.detune / 1200.f);
+    auto fallBehindMs = chainSettings.grainSize * juce::jmax(0.f, 1.f / slowestSpeed - 1.f);
+    return juce::jmax(chainSettings.rangeEnd, chainSettings.grainSize) + fallBehindMs;
+}
+
+// Applies the input gain to the buffer, ramping smoothly to a new value if it has changed
+void GranularDelayAudioProcessor::applyInputGain(juce::AudioBuffer<float>& buffer, float inputGain)
+{
+    inputGainSmoother.setTargetValue(inputGain);
+    auto blockSize = buffer.getNumSamples();
 
-    // Check if there is enough room for full buffer in delayBuffer
-    if (delayBufferSize >= bufferSize + writePosition)
+    if (!inputGainSmoother.isSmoothing())
     {
-        // If so, copy entire buffer over
-        delayBuffer.copyFrom(channel, writePosition, buffer.getWritePointer(channel), bufferSize, gain);
+        buffer.applyGain(inputGainSmoother.getCurrentValue());
+        return;
     }
-    else
+
+    // Fill in the ramp a chunk at a time, then apply it to every channel
+    auto* gainRamp = rampBuffer.getWritePointer(0);
+
+    for (int start = 0; start < blockSize; start += rampBuffer.getNumSamples())
     {
-        // Determine how much space is left at the end / how much to put at start
-        auto numSamplesToEnd = delayBufferSize - writePosition;
-        auto numSamplesLeft = bufferSize - numSamplesToEnd;
+        auto numSamples = juce::jmin(rampBuffer.getNumSamples(), blockSize - start);
 
-        // Copy samples to end / start
-        delayBuffer.copyFrom(channel, writePosition, buffer.getWritePointer(channel), numSamplesToEnd, gain);
-        delayBuffer.copyFrom(channel, 0, buffer.getWritePointer(channel, numSamplesToEnd), numSamplesLeft, gain);
-    }    
+        for (int i = 0; i < numSamples; ++i)
+            gainRamp[i] = inputGainSmoother.getNextValue();
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            juce::FloatVectorOperations::multiply(buffer.getWritePointer(channel, start), gainRamp, numSamples);
+    }
 }
 
-// Reads from all of the grains in the grainVector into the given buffer
-void GranularDelayAudioProcessor::readGrains(juce::AudioBuffer<float>& buffer, int channel)
+// Mixes the wetBuffer into the buffer, ramping smoothly to a new mix if it has changed.
+// The wetBuffer is used as scratch space, so it is left holding garbage.
+void GranularDelayAudioProcessor::mixWetWithDry(juce::AudioBuffer<float>& buffer, float mix)
 {
-    for (size_t i = grainVector.size(); i-- > 0;)
+    mixSmoother.setTargetValue(mix);
+    auto numChannels = getTotalNumInputChannels();
+    auto blockSize = buffer.getNumSamples();
+
+    if (!mixSmoother.isSmoothing())
     {
-        readOneGrain(buffer, grainVector[i], channel);
+        auto currentMix = mixSmoother.getCurrentValue();
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            buffer.applyGain(channel, 0, blockSize, 1.f - currentMix);
+            buffer.addFrom(channel, 0, wetBuffer, channel, 0, blockSize, currentMix);
+        }
+
+        return;
     }
-}
 
-// Reads the given grain into the given buffer at its proper playback speed
-void GranularDelayAudioProcessor::readOneGrain(juce::AudioBuffer<float>& buffer, Grain& grain, int channel)
-{
-    float readPosition = grain.preBlockReadPosition;
-    int bufferSize = buffer.getNumSamples();
-    int grainBufferSize = grain.buffer.getNumSamples();
+    // With a ramp, out = dry + (wet - dry) * mix needs three vector passes and no per-sample branches
+    auto* mixRamp = rampBuffer.getWritePointer(1);
 
-    for (int i = 0; i < bufferSize && readPosition + 1 < grainBufferSize; ++i)
+    for (int start = 0; start < blockSize; start += rampBuffer.getNumSamples())
     {
-        int truncatedPos = static_cast<int>(readPosition);
-        float fraction = readPosition - truncatedPos;
+        auto numSamples = juce::jmin(rampBuffer.getNumSamples(), blockSize - start);
 
-        jassert(truncatedPos + 1 < grainBufferSize);
-        float sample1 = grain.buffer.getSample(channel, truncatedPos);
-        float sample2 = grain.buffer.getSample(channel, truncatedPos + 1); 
-        float interpolatedSample = sample1 * (1 - fraction) + sample2 * fraction;
-        
-        interpolatedSample *= 0.5f; // Could replace with a parameter?
+        for (int i = 0; i < numSamples; ++i)
+            mixRamp[i] = mixSmoother.getNextValue();
 
-        buffer.addSample(channel, i, interpolatedSample);
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* dry = buffer.getWritePointer(channel, start);
+            auto* wet = wetBuffer.getWritePointer(channel, start);
 
-        readPosition += grain.playbackSpeed;
+            juce::FloatVectorOperations::subtract(wet, wet, dry, numSamples);
+            juce::FloatVectorOperations::multiply(wet, mixRamp, numSamples);
+            juce::FloatVectorOperations::add(dry, wet, numSamples);
+        }
     }
+}
+
+// Copies one channel of a buffer to the delayBuffer at the writePosition (the ring wraps it around the end)
+void GranularDelayAudioProcessor::fillDelayBuffer(juce::AudioBuffer<float>& buffer, int channel, float gain)
+{
+    delayBuffer.write(channel, writePosition, buffer.getReadPointer(channel), buffer.getNumSamples(), gain);
+}
+
+// Sums a filtered and limited copy of the wetBuffer into the delayBuffer, on top of the
+// input written there for this sub-block. The grains have to read that input first, so
+// the feedback is added once they're rendered. Grains only ever read behind their own
+// output, so only the shortest grains at high speeds can reach samples this recent, and
+// they hear them without this sub-block's feedback.
+void GranularDelayAudioProcessor::feedBackGrains(int blockSize, float feedback)
+{
+    auto peak = feedbackPath.process(wetBuffer, blockSize, feedback);
+
+    if (peak <= 0.f)
+        return;
+
+    for (int channel = 0; channel < juce::jmin(getTotalNumInputChannels(), DelayBuffer::numChannels); ++channel)
+        delayBuffer.add(channel, writePosition, feedbackPath.getReadPointer(channel), blockSize);
 
-    grain.postBlockReadPostion = readPosition;
+    if (peak >= silenceThreshold)
+        samplesOfSilence = 0;
 }
 
-// Updates the read position of every grain and removes the ones that are finished playing
-void GranularDelayAudioProcessor::cleanUpGrains()
+// Reads numSamples from all of the live grains in the grainPool into the wetBuffer, and
+// retires the grains that finish. Dense clouds are split across the grainWorkerPool when
+// multithreading is on, and the finished grains are retired once the workers are done.
+void GranularDelayAudioProcessor::readGrains(int numSamples, bool multithreaded)
 {
-    // Iterate backwards through the grainVector so erasing does not mess things up
-    for (size_t i = grainVector.size(); i-- > 0;)
+    int numChannels = juce::jmin(wetBuffer.getNumChannels(), DelayBuffer::numChannels);
+
+    float* dest[GrainKernels::maxNumChannels] {};
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        dest[channel] = wetBuffer.getWritePointer(channel);
+
+    // The pool turns the block down if it isn't running yet, or is being stopped
+    if (multithreaded && grainPool.size() >= GrainWorkerPool::minGrainsForWorkers
+        && grainWorkerPool.render(grainPool.size(), dest, numChannels, numSamples,
+                                  readOneGrainForWorker, this, grainPositions))
     {
-        float newReadPosition = grainVector[i].postBlockReadPostion;
-        int grainBufferSize = grainVector[i].buffer.getNumSamples();
-        grainVector[i].preBlockReadPosition = newReadPosition;
+        for (int i = grainPool.size(); i-- > 0;)
+            if (grainPool.isFinished(i))
+                retireGrain(i, numSamples);
+
+        return;
+    }
 
-        if (newReadPosition + 1 >= grainBufferSize)
-            grainVector.erase((grainVector.begin() + static_cast<long>(i)));
+    // Iterate backwards through the grainPool so retiring does not mess things up
+    for (int i = grainPool.size(); i-- > 0;)
+    {
+        readOneGrain(dest, numChannels, numSamples, i, grainPositions);
+
+        if (grainPool.isFinished(i))
+            retireGrain(i, numSamples);
+    }
+}
+
+// Reads the grain at the given index into every dest channel at its proper playback speed,
+// reading straight from the delayBuffer and applying the window and pan on the way, then
+// moves its read position on. The positions are scratch space, so every thread rendering
+// grains needs its own.
+void GranularDelayAudioProcessor::readOneGrain(float* const* dest, int numChannels, int numSamples, int grainIndex,
+                                               GrainKernels::GrainPositions& positions)
+{
+    int blockOffset = grainPool.blockOffset[grainIndex];
+
+    const float* source[GrainKernels::maxNumChannels] {};
+    float* grainDest[GrainKernels::maxNumChannels] {};
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        source[channel] = delayBuffer.getReadPointer(channel);
+        grainDest[channel] = dest[channel] + blockOffset;
     }
+
+    GrainKernels::renderGrain(source, delayBuffer.getCapacity(), grainDest, numChannels,
+                              grainPool.getChannelGains(grainIndex),
+                              grainPool.startSample[grainIndex], grainPool.numSamples[grainIndex],
+                              grainPool.playbackSpeed[grainIndex], grainPool.renderPath[grainIndex],
+                              grainPool.sincTable[grainIndex], *grainPool.window[grainIndex],
+                              grainPool.readPosition[grainIndex], positions, numSamples - blockOffset);
+
+    grainPool.blockOffset[grainIndex] = 0;
+}
+
+// Called by the grainWorkerPool on whichever thread takes the grain. Each grain is only
+// ever handed to one thread, so nothing here needs a lock.
+void GranularDelayAudioProcessor::readOneGrainForWorker(void* processor, int grainIndex, float* const* dest,
+                                                        int numChannels, int numSamples,
+                                                        GrainKernels::GrainPositions& positions)
+{
+    auto& self = *static_cast<GranularDelayAudioProcessor*>(processor);
+    self.readOneGrain(dest, numChannels, numSamples, grainIndex, positions);
+}
+
+// Releases a grain that has finished playing, telling the editor's grain cloud display
+void GranularDelayAudioProcessor::retireGrain(int grainIndex, int blockSize)
+{
+    if (grainTelemetry.isActive())
+        grainTelemetry.push(makeGrainEvent(GrainTelemetry::Event::Type::end, grainIndex, writePosition + blockSize));
+
+    grainPool.release(grainIndex);
+}
+
+// Tells the editor's grain cloud display where every grain is reading, a few dozen times a second
+void GranularDelayAudioProcessor::publishGrainTelemetry(int blockSize)
+{
+    if (!grainTelemetry.advance(blockSize))
+        return;
+
+    for (int i = 0; i < grainPool.size(); ++i)
+        grainTelemetry.push(makeGrainEvent(GrainTelemetry::Event::Type::playhead, i, writePosition + blockSize));
+}
+
+// Describes a live grain for the grain cloud display, as of the given write position
+GrainTelemetry::Event GranularDelayAudioProcessor::makeGrainEvent(GrainTelemetry::Event::Type type, int grainIndex,
+                                                                  int blockEndPosition) const
+{
+    float readPosition = grainPool.readPosition[grainIndex];
+    int numSamples = grainPool.numSamples[grainIndex];
+
+    GrainTelemetry::Event event;
+    event.type = type;
+    event.slot = grainPool.slot[grainIndex];
+    event.delayMs = getDistanceMs(grainPool.startSample[grainIndex] + static_cast<int>(readPosition), blockEndPosition);
+    event.sizeMs = static_cast<float>(numSamples * 1000.0 / getSampleRate());
+    event.speed = grainPool.playbackSpeed[grainIndex];
+    event.progress = readPosition / static_cast<float>(numSamples);
+    event.gain = grainPool.window[grainIndex]->getGain(juce::jlimit(0.f, 1.f, event.progress));
+
+    return event;
+}
+
+// Returns how far behind the given write index the given read index is in the delayBuffer, in ms
+float GranularDelayAudioProcessor::getDistanceMs(int readIndex, int writeIndex) const
+{
+    int distance = delayBuffer.wrap(writeIndex - readIndex);
+
+    return static_cast<float>(distance * 1000.0 / getSampleRate());
 }
 
 // Updates the write position of the delay buffer (after processing a block)
 void GranularDelayAudioProcessor::updateWritePosition(int blockSize)
 {
-    writePosition += blockSize;
-    writePosition %= delayBuffer.getNumSamples();
+    writePosition = delayBuffer.wrap(writePosition + blockSize);
 }
 
 
 //==============================================================================
-// Adds a new grain to the grainVector, taking samples from the delayBuffer
-void GranularDelayAudioProcessor::addGrain()
+// Starts the grains whose onsets fall in this block, timed however the grainTiming says
+void GranularDelayAudioProcessor::scheduleGrains(const ChainSettings& chainSettings, int blockSize)
 {
+    switch (static_cast<GrainTiming>(chainSettings.grainTiming))
+    {
+        case GrainTiming::tempoSync:
+            scheduleSyncedGrains(chainSettings, blockSize);
+            break;
+
+        case GrainTiming::poisson:
+            schedulePoissonGrains(chainSettings, getOnsetsPerSecond(chainSettings), blockSize);
+            break;
+
+        case GrainTiming::free:
+        case GrainTiming::targetOverlap:
+        default:
+            schedulePeriodicGrains(chainSettings, getOnsetsPerSecond(chainSettings), blockSize);
+            break;
+    }
+}
+
+// Starts a new grain at every sample in this block where the grain clock ticks over.
+// The clock counts samples rather than wall-clock time, so onsets land on exact samples,
+// several can fall in one block, and offline renders come out the same every time.
+void GranularDelayAudioProcessor::schedulePeriodicGrains(const ChainSettings& chainSettings,
+                                                         double onsetsPerSecond, int blockSize)
+{
+    double phaseIncrement = onsetsPerSecond / getSampleRate();
+    double samplesPerGrain = 1.0 / phaseIncrement;
+    double samplesUntilNextGrain = (1.0 - grainPhase) * samplesPerGrain;
+
+    while (samplesUntilNextGrain < blockSize)
+    {
+        addGrain(chainSettings, static_cast<int>(samplesUntilNextGrain));
+        samplesUntilNextGrain += samplesPerGrain;
+    }
+
+    grainPhase = 1.0 - (samplesUntilNextGrain - blockSize) * phaseIncrement;
+}
+
+// Starts grains at random times that average onsetsPerSecond. Without a regular grain rate
+// there's nothing for the overlapping grains to comb filter or amplitude modulate at, so a
+// dense cloud sounds smooth rather than buzzing.
+void GranularDelayAudioProcessor::schedulePoissonGrains(const ChainSettings& chainSettings,
+                                                        double onsetsPerSecond, int blockSize)
+{
+    // How long is left to wait doesn't depend on how long has been waited already, so when
+    // the rate changes, scaling what's left by the change in rate gives a wait with the right
+    // distribution at the new rate. Unlike drawing it again, that doesn't use up a random
+    // number every sub-block while the rate is being automated. Only the first wait after a
+    // reset (when there's no rate yet) is drawn.
+    if (!juce::exactlyEqual(onsetsPerSecond, poissonRate))
+    {
+        samplesUntilPoissonGrain = poissonRate > 0.0 ? samplesUntilPoissonGrain * poissonRate / onsetsPerSecond
+                                                     : getPoissonInterval(onsetsPerSecond);
+        poissonRate = onsetsPerSecond;
+    }
+
+    while (samplesUntilPoissonGrain < blockSize)
+    {
+        addGrain(chainSettings, static_cast<int>(samplesUntilPoissonGrain));
+        samplesUntilPoissonGrain += getPoissonInterval(onsetsPerSecond);
+    }
+
+    samplesUntilPoissonGrain -= blockSize;
+}
+
+// Returns how many onsets a second the grain timing asks for on average
+double GranularDelayAudioProcessor::getOnsetsPerSecond(const ChainSettings& chainSettings) const
+{
+    switch (static_cast<GrainTiming>(chainSettings.grainTiming))
+    {
+        case GrainTiming::tempoSync:
+            return syncBpm / (60.0 * getSyncStepLength(chainSettings.syncRate));
+
+        case GrainTiming::targetOverlap:
+        {
+            // This many onsets a second keeps the target number playing whatever the size,
+            // pitch and detune. Grains that don't fit in the grainPool are skipped, so the
+            // target is held to what it can hold, and past one onset a sample more onsets
+            // wouldn't make it any denser.
+            auto overlap = juce::jmin(static_cast<double>(chainSettings.overlap),
+                                      static_cast<double>(grainPool.capacity()));
+            return juce::jmin(overlap / getMeanGrainSeconds(chainSettings), getSampleRate());
+        }
+
+        case GrainTiming::free:
+        case GrainTiming::poisson:
+        default:
+            return chainSettings.frequency;
+    }
+}
+
+// Returns a random number of samples between Poisson onsets: exponentially distributed,
+// with a mean of one onset's worth at the given rate
+double GranularDelayAudioProcessor::getPoissonInterval(double onsetsPerSecond)
+{
+    // nextFloat() is below 1, so this never takes the log of 0
+    return -std::log(1.0 - grainRandom.nextFloat()) * getSampleRate() / onsetsPerSecond;
+}
+
+// Returns how long a grain lasts on average: its size divided by its pitch. Detune spreads
+// the pitch evenly from grainPitch / d to grainPitch * d, where d = 2^(detune / 1200), and
+// over that range 1 / pitch averages 2 ln d / (d - 1 / d) of 1 / grainPitch.
+double GranularDelayAudioProcessor::getMeanGrainSeconds(const ChainSettings& chainSettings)
+{
+    double grainSeconds = chainSettings.grainSize / (1000.0 * chainSettings.grainPitch);
+
+    if (chainSettings.detune > 0.f)
+    {
+        auto detuneFactor = std::pow(2.0, chainSettings.detune / 1200.0);
+        grainSeconds *= 2.0 * std::log(detuneFactor) / (detuneFactor - 1.0 / detuneFactor);
+    }
+
+    return grainSeconds;
+}
+
+// Returns how many grains are expected to be playing at once with these settings
+float GranularDelayAudioProcessor::getExpectedOverlap(const ChainSettings& chainSettings) const
+{
+    return static_cast<float>(getOnsetsPerSecond(chainSettings) * getMeanGrainSeconds(chainSettings)
+                              * chainSettings.probability);
+}
+
+// Returns the gain on top of the fixed window gain that keeps the grains about as loud
+// however many overlap. Grains read from different places in the delayBuffer don't line up,
+// so their power adds and the level goes with the square root of the overlap. Below one
+// grain at a time there's nothing to make up for, so sparse grains aren't boosted further.
+float GranularDelayAudioProcessor::getDensityGain(const ChainSettings& chainSettings) const
+{
+    if (!chainSettings.normaliseDensity)
+        return 1.f;
+
+    return std::sqrt(referenceOverlap / juce::jmax(getExpectedOverlap(chainSettings), 1.f));
+}
+
+// Starts a grain on every step of the tempo grid that falls in this block. Every other step
+// is pushed late by the swing, up to halfway to the step after it. The steps come from the
+// host's transport position, so an offline render gets the same onsets as playback does.
+void GranularDelayAudioProcessor::scheduleSyncedGrains(const ChainSettings& chainSettings, int blockSize)
+{
+    auto stepLength = getSyncStepLength(chainSettings.syncRate);
+    auto quarterNotesPerSample = getQuarterNotesPerSample();
+    auto blockStart = syncPosition;
+    auto blockEnd = syncPosition + blockSize * quarterNotesPerSample;
+    auto swingOffset = 0.5 * chainSettings.swing;
+
+    auto getOnset = [stepLength, swingOffset] (juce::int64 step)
+    {
+        auto isOffBeat = (step & 1) != 0;
+        return (static_cast<double>(step) + (isOffBeat ? swingOffset : 0.0)) * stepLength;
+    };
+
+    // Find the next step again if the step length changed, the host jumped, or the count
+    // has fallen out of step with the position while grains weren't being scheduled
+    if (!juce::exactlyEqual(stepLength, syncStepLength) || getOnset(nextSyncStep) < blockStart - stepLength
+                                                         || getOnset(nextSyncStep) > blockEnd + 2.0 * stepLength)
+    {
+        syncStepLength = stepLength;
+        nextSyncStep = static_cast<juce::int64>(std::floor(blockStart / stepLength)) - 1;
+
+        while (getOnset(nextSyncStep) < blockStart)
+            ++nextSyncStep;
+    }
+
+    for (; getOnset(nextSyncStep) < blockEnd; ++nextSyncStep)
+    {
+        auto blockOffset = static_cast<int>((getOnset(nextSyncStep) - blockStart) / quarterNotesPerSample);
+        addGrain(chainSettings, juce::jlimit(0, blockSize - 1, blockOffset));
+    }
+}
+
+// Takes the transport position and tempo from the host for tempo sync, once per host block.
+// While the transport is stopped, or if the host doesn't say, the position carries on at the
+// last tempo it knew, so synced grains keep a steady pulse.
+void GranularDelayAudioProcessor::readHostPosition()
+{
+    auto* playHead = getPlayHead();
+
+    if (playHead == nullptr)
+        return;
+
+    auto position = playHead->getPosition();
+
+    if (!position.hasValue())
+        return;
+
+    if (auto bpm = position->getBpm(); bpm.hasValue() && *bpm > 0.0)
+        syncBpm = *bpm;
+
+    if (auto ppq = position->getPpqPosition(); ppq.hasValue() && position->getIsPlaying())
+    {
+        // More than a few samples out means the host looped or moved the playhead
+        if (std::abs(*ppq - syncPosition) > 4.0 * getQuarterNotesPerSample())
+            syncStepLength = 0.0;
+
+        syncPosition = *ppq;
+    }
+}
+
+double GranularDelayAudioProcessor::getQuarterNotesPerSample() const
+{
+    return syncBpm / (60.0 * getSampleRate());
+}
+
+// Moves the range to the nearest whole number of sync steps at the current tempo
+void GranularDelayAudioProcessor::snapRangeToTempo(ChainSettings& chainSettings) const
+{
+    auto stepMs = static_cast<float>(getSyncStepLength(chainSettings.syncRate) * 60000.0 / syncBpm);
+
+    auto snap = [this, stepMs] (float ms)
+    {
+        auto snapped = std::round(ms / stepMs) * stepMs;
+        return snapped > rangeEndLimitMs ? snapped - stepMs : snapped;
+    };
+
+    chainSettings.rangeStart = snap(chainSettings.rangeStart);
+    chainSettings.rangeEnd = snap(chainSettings.rangeEnd);
+}
+
+// Takes a grain from the grainPool and points it at a window of the delayBuffer.
+// The grain starts playing blockOffset samples into the current block. The onset
+// probability and the spread only draw random numbers when they're in use, so at their
+// defaults the random sequence isn't touched and the grains land where they always did.
+void GranularDelayAudioProcessor::addGrain(const ChainSettings& chainSettings, int blockOffset)
+{
+    // Let the onset pass without a grain as often as the probability says
+    if (chainSettings.probability < 1.f && grainRandom.nextFloat() >= chainSettings.probability)
+        return;
+
     int sampleRate = static_cast<int>(getSampleRate());
-    auto chainSettings = getChainSettings(apvts);
     float grainSize = chainSettings.grainSize;
-    int grainSizeSamples = static_cast<int>(grainSize * sampleRate / 1000);
+    int index = grainPool.add();
 
-    int startSample = getGrainStartSample();
-    float pitch = getGrainPitch();
-	
-    // Copy audio from delayBuffer to new AudioBuffer
-	auto grainBuffer = juce::AudioBuffer<float>(2, grainSizeSamples);
-    grainBuffer.clear();
+    // If every grain is already playing, skip this one rather than allocate
+    if (index < 0)
+        return;
 
-    for (int channel = 0; channel < getTotalNumInputChannels(); ++channel)
+    int grainSizeSamples = static_cast<int>(grainSize * sampleRate / 1000);
+    float playbackSpeed = getGrainPitch(chainSettings);
+
+    grainPool.startSample[index] = getGrainStartSample(chainSettings, grainSizeSamples, blockOffset);
+    grainPool.numSamples[index] = grainSizeSamples;
+    grainPool.blockOffset[index] = blockOffset;
+    grainPool.playbackSpeed[index] = playbackSpeed;
+    grainPool.renderPath[index] = GrainKernels::getRenderPath(playbackSpeed, getGrainInterpolation(chainSettings));
+    grainPool.sincTable[index] = sincTables.getTable(playbackSpeed);
+    grainPool.window[index] = windowTables.getTable(static_cast<GrainKernels::WindowShape>(chainSettings.grainWindow));
+
+    // Scatter the grain across the stereo field, up to as far either side as the spread allows
+    if (chainSettings.spread > 0.f && getTotalNumInputChannels() > 1)
     {
-        fillGrainBuffer(grainBuffer, channel, startSample);
+        float pan = chainSettings.spread * (2.f * grainRandom.nextFloat() - 1.f);
+        panTable.getGains(pan, grainPool.getChannelGains(index));
     }
-    
-    // Apply fade envelope to the grain buffer
-    int fadeLengthSamples = grainSizeSamples / 5;
-    grainBuffer.applyGainRamp(0, fadeLengthSamples, 0, 1);
-    grainBuffer.applyGainRamp(grainSizeSamples - fadeLengthSamples, fadeLengthSamples, 1, 0);
 
-    // Initialize Grain object and add it to the vector
-	Grain grain;
-    grain.buffer = grainBuffer;    
-    grain.playbackSpeed = pitch;
+    // The density gain rides on the channel gains, which every kernel already applies
+    if (chainSettings.normaliseDensity)
+    {
+        auto densityGain = getDensityGain(chainSettings);
+        auto* channelGains = grainPool.getChannelGains(index);
+
+        for (int channel = 0; channel < GrainKernels::maxNumChannels; ++channel)
+            channelGains[channel] *= densityGain;
+    }
 
-    grainVector.push_back(grain);
+    if (grainTelemetry.isActive())
+        grainTelemetry.push(makeGrainEvent(GrainTelemetry::Event::Type::spawn, index, writePosition + blockOffset));
 }
 
-// Returns a random start sample within the bounds set by the rangeStart and rangeEnd parameters
-int GranularDelayAudioProcessor::getGrainStartSample()
+// Returns a random start sample within the bounds set by the rangeStart and rangeEnd parameters.
+// The whole grain has to lie behind the writePosition, otherwise fillDelayBuffer would
+// overwrite the end of the grain while it is still being read.
+int GranularDelayAudioProcessor::getGrainStartSample(const ChainSettings& chainSettings,
+                                                     int grainSizeSamples, int blockOffset)
 {
     int sampleRate = static_cast<int>(getSampleRate());
-    int delayBufferSize = delayBuffer.getNumSamples();
-    auto chainSettings = getChainSettings(apvts);
     float rangeStart = chainSettings.rangeStart;
     float rangeEnd = chainSettings.rangeEnd;
 
-    int rangeStartSamples = static_cast<int>(rangeStart * sampleRate / 1000.f);
-    int rangeEndSamples = static_cast<int>(rangeEnd * sampleRate / 1000.f);
-
-    int maxStartSample = writePosition - rangeStartSamples + delayBufferSize;
-	int minStartSample = writePosition - rangeEndSamples + delayBufferSize;
+    // Leave room for the interpolation taps that read past the end of the grain
+    int lookAheadSamples = GrainKernels::SincTable::numTaps / 2;
 
-    jassert(minStartSample <= maxStartSample); 
+    int rangeStartSamples = juce::jmax(static_cast<int>(rangeStart * sampleRate / 1000.f), 
+                                       grainSizeSamples + lookAheadSamples);
+    int rangeEndSamples = juce::jmax(static_cast<int>(rangeEnd * sampleRate / 1000.f), rangeStartSamples);
 
-    int startSample = minStartSample;
-    if (minStartSample != maxStartSample)
+    // The random part is worked out as an offset into the range, so where a grain lands
+    // doesn't depend on the size of the delayBuffer (which reserveRangeEnd() can change)
+    int startSample = writePosition + blockOffset - rangeEndSamples;
+    if (rangeEndSamples != rangeStartSamples)
     {
-        juce::Random random;
-        float startSampleFloat = juce::jmap(random.nextFloat(), 0.0f, 1.0f, 
-                                            static_cast<float>(minStartSample),
-                                            static_cast<float>(maxStartSample));
-        startSample = static_cast<int>(startSampleFloat);
+        auto offset = grainRandom.nextFloat() * static_cast<float>(rangeEndSamples - rangeStartSamples);
+        startSample += static_cast<int>(offset);
     }
 
-    if (startSample > delayBufferSize)
-            startSample -= delayBufferSize;
-
-    return startSample;
+    return delayBuffer.wrap(startSample);
 }
 
 // Returns a random pitch / playback speed value within the range set by the pitch and detune parameters
-float GranularDelayAudioProcessor::getGrainPitch()
+float GranularDelayAudioProcessor::getGrainPitch(const ChainSettings& chainSettings)
 {
-    auto chainSettings = getChainSettings(apvts);
     float grainPitch = chainSettings.grainPitch;
     float detune = chainSettings.detune;
     float pitch;
@@ -352,46 +895,123 @@ float GranularDelayAudioProcessor::getGrainPitch()
         float minPitch = grainPitch * detuneFactor;
         float maxPitch = grainPitch / detuneFactor;
 
-        juce::Random random;
-        pitch = juce::jmap(random.nextFloat(), 0.0f, 1.0f, minPitch, maxPitch);
+        pitch = juce::jmap(grainRandom.nextFloat(), 0.0f, 1.0f, minPitch, maxPitch);
     }
     
     return pitch;
 }
 
-// Fills a grain's AudioBuffer with samples from the delayBuffer, wrapping around if needed.
-void GranularDelayAudioProcessor::fillGrainBuffer(juce::AudioBuffer<float>& grainBuffer, 
-                                                  int channel, int startSample)
+// Returns the interpolation to use for a new grain. The sinc kernel is much more expensive
+// than the others, so unless asked otherwise it only runs in offline renders and
+// realtime playback gets Hermite instead.
+GrainKernels::Interpolation GranularDelayAudioProcessor::getGrainInterpolation(const ChainSettings& chainSettings)
 {
-    int grainBufferSize = grainBuffer.getNumSamples();
-    int delayBufferSize = delayBuffer.getNumSamples();
+    auto interpolation = static_cast<GrainKernels::Interpolation>(chainSettings.interpolation);
 
-    // Check if there are enough samples in delayBuffer left to fill the grain buffer
-    if (delayBufferSize > grainBufferSize + startSample)
-    {
-        // If so, add mainBufferSize samples
-        grainBuffer.copyFrom(channel, 0, delayBuffer.getReadPointer(channel, startSample), grainBufferSize);
-    }
-    else
-    {
-        // Determine how many samples are left at the end / how much to get from the start
-        auto numSamplesToEnd = delayBufferSize - startSample;
-        auto numSamplesLeft = grainBufferSize - numSamplesToEnd;
+    if (interpolation == GrainKernels::Interpolation::sinc && chainSettings.sincRenderOnly && !isNonRealtime())
+        return GrainKernels::Interpolation::hermite;
 
-        // Add samples from end / start of delayBuffer
-        grainBuffer.copyFrom(channel, 0, delayBuffer.getReadPointer(channel, startSample), numSamplesToEnd);
-        grainBuffer.copyFrom(channel, numSamplesToEnd, delayBuffer.getReadPointer(channel, 0), numSamplesLeft);
-    }
+    return interpolation;
 }
 
+// Returns the most grains that can be playing at once: the longest, slowest grain
+// lasts maxGrainSize / minPitch, and at most maxFrequency grains start per second
+int GranularDelayAudioProcessor::getMaxNumGrains() const
+{
+    auto maxGrainSizeMs = apvts.getParameterRange("grainSize").end;
+    auto maxFrequency = apvts.getParameterRange("frequency").end;
+    auto maxDetuneFactor = std::pow(2.f, apvts.getParameterRange("detune").end / 1200.f);
+    auto minPitch = apvts.getParameterRange("grainPitch").start / maxDetuneFactor;
+
+    auto longestGrainSeconds = maxGrainSizeMs / 1000.f / minPitch;
+    auto maxOverlap = juce::jmax(longestGrainSeconds * maxFrequency, apvts.getParameterRange("overlap").end);
 
-//==============================================================================
-void GranularDelayAudioProcessor::timerCallback()
+    // Poisson onsets bunch up, so leave room for the overlap to run well past its average
+    return static_cast<int>(std::ceil(maxOverlap + 4.f * std::sqrt(maxOverlap))) + 1;
+}
+
+// Returns the furthest behind the writePosition a live grain can ever read: where the
+// furthest grain starts, plus however far the slowest grain falls behind while it plays
+// (see getReachMs), plus the interpolation taps either side of the read position
+int GranularDelayAudioProcessor::getMaxReadDistance(double sampleRate, float rangeEndMs) const
+{
+    auto maxGrainSizeMs = apvts.getParameterRange("grainSize").end;
+    auto maxDetuneFactor = std::pow(2.f, apvts.getParameterRange("detune").end / 1200.f);
+    auto minPitch = apvts.getParameterRange("grainPitch").start / maxDetuneFactor;
+
+    auto maxStartMs = juce::jmax(rangeEndMs, maxGrainSizeMs);
+    auto fallBehindMs = maxGrainSizeMs * juce::jmax(0.f, 1.f / minPitch - 1.f);
+    auto tapSamples = GrainKernels::SincTable::numTaps + 1;
+    return static_cast<int>(std::ceil((maxStartMs + fallBehindMs) * sampleRate / 1000.0)) + tapSamples;
+}
+
+// Returns the smallest power of two that holds the furthest read plus the sub-block being written
+int GranularDelayAudioProcessor::getDelayBufferSize(int maxReadDistance)
+{
+    return juce::nextPowerOfTwo(maxReadDistance + subBlockSize + 1);
+}
+
+void GranularDelayAudioProcessor::reserveRangeEnd(float newMaxRangeEndMs)
 {
-    grainRequested.store(true);
-    timer.startTimer(timerInterval);
+    maxRangeEndMs = juce::jmax(maxRangeEndMs, newMaxRangeEndMs);
+
+    // Not playing yet, so prepareToPlay will size the buffer
+    if (requestedDelayBufferSize == 0)
+    {
+        rangeEndLimitMs = maxRangeEndMs;
+        return;
+    }
+
+    auto newSize = getDelayBufferSize(getMaxReadDistance(getSampleRate(), maxRangeEndMs));
+
+    if (newSize <= requestedDelayBufferSize)
+        return;
+
+    auto newBuffer = std::make_unique<PendingDelayBuffer>();
+    newBuffer->buffer.setSize(newSize);
+    newBuffer->rangeEndLimitMs = maxRangeEndMs;
+    requestedDelayBufferSize = newSize;
+
+    // Replace any buffer the audio thread hasn't picked up yet, then free the one it handed
+    // back last time. It won't pick up a new buffer until that one is gone.
+    delete pendingDelayBuffer.exchange(newBuffer.release(), std::memory_order_acq_rel);
+    delete retiredDelayBuffer.exchange(nullptr, std::memory_order_acq_rel);
 }
 
+// Moves the delay history into the bigger buffer from reserveRangeEnd(), keeping every
+// sample (and every grain) the same distance behind the write position, then hands the
+// old buffer back to the message thread to free. Only copies, so it's realtime safe.
+void GranularDelayAudioProcessor::swapInPendingDelayBuffer()
+{
+    auto* pending = pendingDelayBuffer.exchange(nullptr, std::memory_order_acq_rel);
+
+    if (pending == nullptr)
+        return;
+
+    auto& newBuffer = pending->buffer;
+    int oldSize = delayBuffer.getCapacity();
+    int growth = newBuffer.getCapacity() - oldSize;
+    jassert(growth >= 0);
+
+    // Samples before the writePosition keep their index, and the older ones after it
+    // move up to the end of the new buffer
+    for (int channel = 0; channel < DelayBuffer::numChannels; ++channel)
+    {
+        auto* oldSamples = delayBuffer.getReadPointer(channel);
+        newBuffer.write(channel, 0, oldSamples, writePosition);
+        newBuffer.write(channel, writePosition + growth, oldSamples + writePosition, oldSize - writePosition);
+    }
+
+    for (int i = 0; i < grainPool.size(); ++i)
+        if (grainPool.startSample[i] >= writePosition)
+            grainPool.startSample[i] += growth;
+
+    // Snapping to the tempo can now go as far as the new buffer reaches
+    rangeEndLimitMs = pending->rangeEndLimitMs;
+
+    delayBuffer.swap(newBuffer);
+    retiredDelayBuffer.store(pending, std::memory_order_release);
+}
 
 //==============================================================================
 bool GranularDelayAudioProcessor::hasEditor() const
@@ -423,24 +1043,107 @@ void GranularDelayAudioProcessor::setStateInformation (const void* data, int siz
     auto tree = juce::ValueTree::readFromData(data, static_cast<size_t>(sizeInBytes));
     if (tree.isValid()) 
     {
+        // States saved before the seed was stored keep this instance's seed
+        auto seed = getRandomSeed();
         apvts.replaceState(tree);
+
+        if (apvts.state.hasProperty("randomSeed"))
+            randomSeed.store(static_cast<juce::int64>(apvts.state.getProperty("randomSeed")));
+        else
+            setRandomSeed(seed);
     }
 }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+juce::int64 GranularDelayAudioProcessor::getRandomSeed() const
+{
+    return randomSeed.load();
+}
+
+// The state tree saves the seed, and the atomic copy lets reset() read it on the audio thread
+void GranularDelayAudioProcessor::setRandomSeed(juce::int64 seed)
+{
+    apvts.state.setProperty("randomSeed", seed, nullptr);
+    randomSeed.store(seed);
+}
+
+//==============================================================================
+namespace
+{
+    // The note values tempo-synced grains can step in, in the order of the syncRate choices
+    struct NoteValue
+    {
+        const char* name;
+        double quarterNotes;
+    };
+
+    constexpr NoteValue syncNoteValues[] =
+    {
+        { "1/1", 4.0 },          { "1/2", 2.0 },          { "1/4", 1.0 },
+        { "1/8", 0.5 },          { "1/16", 0.25 },        { "1/32", 0.125 },
+        { "1/2T", 4.0 / 3.0 },   { "1/4T", 2.0 / 3.0 },   { "1/8T", 1.0 / 3.0 },   { "1/16T", 1.0 / 6.0 },
+        { "1/2D", 3.0 },         { "1/4D", 1.5 },         { "1/8D", 0.75 },        { "1/16D", 0.375 }
+    };
+
+    constexpr int defaultSyncRate = 4; // 1/16
+}
+
+// Returns the length of a tempo sync step in quarter notes
+double GranularDelayAudioProcessor::getSyncStepLength(int syncRate)
+{
+    return syncNoteValues[juce::jlimit(0, static_cast<int>(std::size(syncNoteValues)) - 1, syncRate)].quarterNotes;
+}
+
+//==============================================================================
+ChainParameters::ChainParameters(juce::AudioProcessorValueTreeState& apvts)
+    : inputGain(apvts.getRawParameterValue("inputGain")),
+      mix(apvts.getRawParameterValue("mix")),
+      grainSize(apvts.getRawParameterValue("grainSize")),
+      frequency(apvts.getRawParameterValue("frequency")),
+      rangeStart(apvts.getRawParameterValue("rangeStart")),
+      rangeEnd(apvts.getRawParameterValue("rangeEnd")),
+      grainPitch(apvts.getRawParameterValue("grainPitch")),
+      detune(apvts.getRawParameterValue("detune")),
+      spread(apvts.getRawParameterValue("spread")),
+      feedback(apvts.getRawParameterValue("feedback")),
+      swing(apvts.getRawParameterValue("swing")),
+      probability(apvts.getRawParameterValue("probability")),
+      overlap(apvts.getRawParameterValue("overlap")),
+      interpolation(apvts.getRawParameterValue("interpolation")),
+      grainWindow(apvts.getRawParameterValue("grainWindow")),
+      grainTiming(apvts.getRawParameterValue("grainTiming")),
+      syncRate(apvts.getRawParameterValue("syncRate")),
+      sincRenderOnly(apvts.getRawParameterValue("sincRenderOnly")),
+      multithreaded(apvts.getRawParameterValue("multithreaded")),
+      rangeSync(apvts.getRawParameterValue("rangeSync")),
+      normaliseDensity(apvts.getRawParameterValue("normaliseDensity"))
+{
+}
+
+ChainSettings ChainParameters::load() const
 {
     ChainSettings settings;
 
-    settings.inputGain = apvts.getRawParameterValue("inputGain")->load();
-    settings.mix = apvts.getRawParameterValue("mix")->load();
-    settings.grainSize = apvts.getRawParameterValue("grainSize")->load();
-    settings.frequency = apvts.getRawParameterValue("frequency")->load();
-    settings.rangeStart = apvts.getRawParameterValue("rangeStart")->load();
-    settings.rangeEnd = apvts.getRawParameterValue("rangeEnd")->load();
-    settings.grainPitch = apvts.getRawParameterValue("grainPitch")->load();
-    settings.detune = apvts.getRawParameterValue("detune")->load();
-    settings.dummy2 = apvts.getRawParameterValue("dummy2")->load();
-    settings.dummy4 = apvts.getRawParameterValue("dummy4")->load();
+    settings.inputGain = inputGain->load();
+    settings.mix = mix->load();
+    settings.grainSize = grainSize->load();
+    settings.frequency = frequency->load();
+    settings.rangeStart = rangeStart->load();
+    settings.rangeEnd = rangeEnd->load();
+    settings.grainPitch = grainPitch->load();
+    settings.detune = detune->load();
+    settings.spread = spread->load();
+    settings.feedback = feedback->load();
+    settings.swing = swing->load();
+    settings.probability = probability->load();
+    settings.overlap = overlap->load();
+    settings.interpolation = static_cast<int>(interpolation->load());
+    settings.grainWindow = static_cast<int>(grainWindow->load());
+    settings.grainTiming = static_cast<int>(grainTiming->load());
+    settings.syncRate = static_cast<int>(syncRate->load());
+    settings.sincRenderOnly = sincRenderOnly->load() > 0.5f;
+    settings.multithreaded = multithreaded->load() > 0.5f;
+    settings.rangeSync = rangeSync->load() > 0.5f;
+    settings.normaliseDensity = normaliseDensity->load() > 0.5f;
 
     return settings;
 }
@@ -473,9 +1176,37 @@ juce::AudioProcessorValueTreeState::ParameterLayout
     layout.add(std::make_unique<juce::AudioParameterFloat>("detune", "Detune",
                                 juce::NormalisableRange<float>(0.f, 500.f, 0.f, 0.5f), 0.f));
 
-    layout.add(std::make_unique<juce::AudioParameterFloat>("dummy2", "dummy2", 0.f, 1.f, 0.5f));
+    layout.add(std::make_unique<juce::AudioParameterFloat>("spread", "Spread", 0.f, 1.f, 0.f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("feedback", "Feedback", 0.f, 0.95f, 0.f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("interpolation", "Interpolation",
+                                juce::StringArray { "Linear", "Hermite", "Sinc" }, 0));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("grainWindow", "Grain Window",
+                                juce::StringArray { "Trapezoid", "Hann", "Tukey", "Gaussian", "Exponential Decay" }, 0));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("grainTiming", "Grain Timing",
+                                juce::StringArray { "Free", "Tempo Sync", "Poisson", "Target Overlap" }, 0));
+
+    juce::StringArray syncRateNames;
+    for (auto& noteValue : syncNoteValues)
+        syncRateNames.add(noteValue.name);
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("syncRate", "Sync Rate", syncRateNames, defaultSyncRate));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("swing", "Swing", 0.f, 1.f, 0.f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("probability", "Onset Probability", 0.f, 1.f, 1.f));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("rangeSync", "Snap Range To Tempo", false));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("overlap", "Target Overlap", 1.f, 16.f, 4.f));
+
+    layout.add(std::make_unique<juce::AudioParameterBool>("normaliseDensity", "Normalise Density", false));
 
-    layout.add(std::make_unique<juce::AudioParameterFloat>("dummy4", "dummy4", 0.f, 1.f, 0.5f));
+    layout.add(std::make_unique<juce::AudioParameterBool>("sincRenderOnly", "Sinc Only When Rendering", true));
+    layout.add(std::make_unique<juce::AudioParameterBool>("multithreaded", "Multithreaded Grains", false));
 
     return layout;
 }
@@ -2,7 +2,17 @@
 
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
-#include <juce_audio_utils/gui/juce_AudioVisualiserComponent.h>
+
+#include "FeedbackPath.h"
+#include "GrainKernels.h"
+#include "GrainPool.h"
+#include "GrainRandom.h"
+#include "GrainTelemetry.h"
+#include "GrainWorkerPool.h"
+#include "RingBuffer.h"
+#include "WaveformFeed.h"
+
+#include <mutex>
 
 struct ChainSettings
 {
@@ -14,23 +24,56 @@ struct ChainSettings
     float rangeEnd;
     float grainPitch;
     float detune;
-    float dummy2;
-    float dummy4;
+    float spread;
+    float feedback;
+    float swing;
+    float probability;
+    float overlap;
+    int interpolation;
+    int grainWindow;
+    int grainTiming;
+    int syncRate;
+    bool sincRenderOnly;
+    bool multithreaded;
+    bool rangeSync;
+    bool normaliseDensity;
 };
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
-
-//==============================================================================
-struct Grain
+// Pointers to the raw parameter values, looked up by ID once at construction so that
+// taking a snapshot of the parameters on the audio thread needs no string lookups
+struct ChainParameters
 {
-    juce::AudioBuffer<float> buffer;
-    float preBlockReadPosition = 0;
-    float postBlockReadPostion = 0;
-    float playbackSpeed;
+    explicit ChainParameters(juce::AudioProcessorValueTreeState& apvts);
+
+    ChainSettings load() const;
+
+    std::atomic<float>* inputGain;
+    std::atomic<float>* mix;
+    std::atomic<float>* grainSize;
+    std::atomic<float>* frequency;
+    std::atomic<float>* rangeStart;
+    std::atomic<float>* rangeEnd;
+    std::atomic<float>* grainPitch;
+    std::atomic<float>* detune;
+    std::atomic<float>* spread;
+    std::atomic<float>* feedback;
+    std::atomic<float>* swing;
+    std::atomic<float>* probability;
+    std::atomic<float>* overlap;
+    std::atomic<float>* interpolation;
+    std::atomic<float>* grainWindow;
+    std::atomic<float>* grainTiming;
+    std::atomic<float>* syncRate;
+    std::atomic<float>* sincRenderOnly;
+    std::atomic<float>* multithreaded;
+    std::atomic<float>* rangeSync;
+    std::atomic<float>* normaliseDensity;
 };
 
 //==============================================================================
-class GranularDelayAudioProcessor final : public juce::AudioProcessor
+class GranularDelayAudioProcessor final : public juce::AudioProcessor,
+                                          private juce::AudioProcessorValueTreeState::Listener,
+                                          private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -40,6 +83,7 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
@@ -74,32 +118,162 @@ public:
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, 
         "Parameters", createParameterLayout()};
 
-    juce::AudioVisualiserComponent waveViewer;
+    // The input waveform, for the editor to draw
+    WaveformFeed& getWaveformFeed() { return waveformFeed; }
+
+    // Grain spawns and playheads, for the editor's grain cloud display
+    GrainTelemetry& getGrainTelemetry() { return grainTelemetry; }
+
+    // Grows the delayBuffer so grains can read up to maxRangeEndMs behind the input, for
+    // when the range limits are raised while playing. Safe to call on the message thread:
+    // the new buffer is allocated here and swapped in at the start of the next block, and
+    // the old one is freed here on the next call (or by prepareToPlay or the destructor).
+    void reserveRangeEnd(float maxRangeEndMs);
+
+    // The delayBuffer's size in samples. Only for the tests, which call it between blocks.
+    int getDelayBufferCapacity() const { return delayBuffer.getCapacity(); }
+
+    // How far behind the input grains can read when the range goes up to rangeEndMs, and the
+    // delayBuffer size that holds that much. Public so the tests can check the sizing.
+    int getMaxReadDistance(double sampleRate, float rangeEndMs) const;
+    static int getDelayBufferSize(int maxReadDistance);
+
+    // The number of grains playing at the end of the last block
+    int getNumLiveGrains() const { return grainPool.size(); }
+
+    // The seed for the grains' random start positions and pitches, which is saved with the
+    // plugin state. A new seed takes effect the next time playback is prepared, and from
+    // there the same seed and settings always give the same output.
+    juce::int64 getRandomSeed() const;
+    void setRandomSeed(juce::int64 seed);
+
+    // processBlock works through whatever the host sends in sub-blocks of at most this many
+    // samples, so every scratch buffer has a fixed size and the parameters are read again
+    // at the start of each sub-block
+    static constexpr int subBlockSize = GrainKernels::subBlockSize;
+
+    // How grain onsets are timed: by the free-running frequency, on a grid of note values
+    // that follows the host's tempo and transport, at random (Poisson) times averaging the
+    // frequency, or as often as it takes to keep the target overlap of grains playing
+    enum class GrainTiming
+    {
+        free,
+        tempoSync,
+        poisson,
+        targetOverlap
+    };
 
 private:
     //==============================================================================
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    void updateGrainWorkers(int numChannels);
+
     void fillDelayBuffer(juce::AudioBuffer<float>& buffer, int channel, float gain);
-    void readGrains(juce::AudioBuffer<float>& buffer, int channel);
-    void readOneGrain(juce::AudioBuffer<float>& buffer, Grain& grain, int channel);
+    void feedBackGrains(int blockSize, float feedback);
+    void processSubBlock(juce::AudioBuffer<float>& buffer);
+    void readGrains(int numSamples, bool multithreaded);
+    void readOneGrain(float* const* dest, int numChannels, int numSamples, int grainIndex,
+                      GrainKernels::GrainPositions& positions);
+    static void readOneGrainForWorker(void* processor, int grainIndex, float* const* dest, int numChannels,
+                                      int numSamples, GrainKernels::GrainPositions& positions);
     void updateWritePosition(int blockSize);
-    void cleanUpGrains();
-    void addGrain();
-    int getGrainStartSample();
-    float getGrainPitch();
-    void fillGrainBuffer(juce::AudioBuffer<float>& grainBuffer, int channel, int startSample);
-
-    void timerCallback();
+    void retireGrain(int grainIndex, int blockSize);
+    void publishGrainTelemetry(int blockSize);
+    GrainTelemetry::Event makeGrainEvent(GrainTelemetry::Event::Type type, int grainIndex, int blockEndPosition) const;
+    float getDistanceMs(int readIndex, int writeIndex) const;
+    bool updateSilence(const juce::AudioBuffer<float>& buffer, const ChainSettings& chainSettings);
+    static float getReachMs(const ChainSettings& chainSettings);
+    void applyInputGain(juce::AudioBuffer<float>& buffer, float inputGain);
+    void mixWetWithDry(juce::AudioBuffer<float>& buffer, float mix);
+    void scheduleGrains(const ChainSettings& chainSettings, int blockSize);
+    void schedulePeriodicGrains(const ChainSettings& chainSettings, double onsetsPerSecond, int blockSize);
+    void schedulePoissonGrains(const ChainSettings& chainSettings, double onsetsPerSecond, int blockSize);
+    void scheduleSyncedGrains(const ChainSettings& chainSettings, int blockSize);
+    double getOnsetsPerSecond(const ChainSettings& chainSettings) const;
+    double getPoissonInterval(double onsetsPerSecond);
+    static double getMeanGrainSeconds(const ChainSettings& chainSettings);
+    float getExpectedOverlap(const ChainSettings& chainSettings) const;
+    float getDensityGain(const ChainSettings& chainSettings) const;
+    void readHostPosition();
+    double getQuarterNotesPerSample() const;
+    static double getSyncStepLength(int syncRate);
+    void snapRangeToTempo(ChainSettings& chainSettings) const;
+    void addGrain(const ChainSettings& chainSettings, int blockOffset);
+    int getGrainStartSample(const ChainSettings& chainSettings, int grainSizeSamples, int blockOffset);
+    float getGrainPitch(const ChainSettings& chainSettings);
+    GrainKernels::Interpolation getGrainInterpolation(const ChainSettings& chainSettings);
+    int getMaxNumGrains() const;
+    void swapInPendingDelayBuffer();
 
     //==============================================================================
-    juce::TimedCallback timer;
-    std::vector<Grain> grainVector;
+    ChainParameters chainParameters;
+    juce::SmoothedValue<float> inputGainSmoother;
+    juce::SmoothedValue<float> mixSmoother;
+    juce::AudioBuffer<float> rampBuffer;
 
-    juce::AudioBuffer<float> delayBuffer;
+    GrainPool grainPool;
+    GrainKernels::GrainPositions grainPositions;
+    GrainKernels::SincTables sincTables;
+    GrainKernels::WindowTables windowTables;
+    GrainKernels::PanTable panTable;
+    GrainRandom grainRandom;
+    std::atomic<juce::int64> randomSeed { 0 };
+    GrainWorkerPool grainWorkerPool;
+    std::mutex grainWorkerLock;
+    int grainWorkerChannels { 0 }; // The channels the grainWorkerPool is for, or 0 before prepareToPlay
+    WaveformFeed waveformFeed;
+    GrainTelemetry grainTelemetry;
+
+    using DelayBuffer = RingBuffer<GrainKernels::maxNumChannels>;
+    static_assert(DelayBuffer::guardSize >= GrainKernels::minRingGuardSize,
+                  "The grain kernels read further past the ends of the delayBuffer than its guards cover");
+
+    DelayBuffer delayBuffer;
     juce::AudioBuffer<float> wetBuffer;
-    std::atomic<bool> grainRequested { false };
-    std::atomic<int> timerInterval { 10 };
+    FeedbackPath feedbackPath;
+    double grainPhase { 0.0 };
     int writePosition { 0 };
 
+    // Poisson timing: the samples left until the next onset, drawn at poissonRate onsets per second
+    double samplesUntilPoissonGrain { 0.0 };
+    double poissonRate { 0.0 };
+
+    // With density normalisation, grains are scaled to sound about as loud together as this
+    // many do at the fixed gain, which is how many overlap at the default settings
+    static constexpr float referenceOverlap = 2.5f;
+
+    // Tempo sync. The position is where the host's transport is, in quarter notes. It carries
+    // on at the last known tempo between blocks and whenever the host doesn't say. The next
+    // step is counted in steps of syncStepLength quarter notes, which is 0 when the step has
+    // to be found again from the position.
+    double syncPosition { 0.0 };
+    double syncBpm { 120.0 };
+    double syncStepLength { 0.0 };
+    juce::int64 nextSyncStep { 0 };
+
+    // The longest range the delayBuffer holds, which snapping to the tempo mustn't go past.
+    // It starts at the longest range the parameters allow.
+    float rangeEndLimitMs { 0.f };
+
+    // Input quieter than this counts as silence (about -100 dBFS)
+    static constexpr float silenceThreshold = 1.0e-5f;
+    int samplesOfSilence { 0 };
+
+    // Handing a bigger delayBuffer to the audio thread, and the old one back again. The
+    // pending buffer carries the range it was sized for, which the audio thread takes on
+    // in the same swap.
+    struct PendingDelayBuffer
+    {
+        DelayBuffer buffer;
+        float rangeEndLimitMs { 0.f };
+    };
+
+    float maxRangeEndMs { 0.f };
+    int requestedDelayBufferSize { 0 };
+    std::atomic<PendingDelayBuffer*> pendingDelayBuffer { nullptr };
+    std::atomic<PendingDelayBuffer*> retiredDelayBuffer { nullptr };
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GranularDelayAudioProcessor)
 };
@@ -0,0 +1,211 @@
+#include "RealtimeCheck.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if __has_include(<execinfo.h>)
+ #include <execinfo.h>
+ #include <unistd.h>
+ #define GRANULAR_DELAY_HAS_BACKTRACE 1
+#endif
+
+#if GRANULAR_DELAY_REALTIME_CHECK_LIBC
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+
+namespace
+{
+    constexpr int maxStackFrames = 32;
+
+    // Everything here is trivially initialised, so touching it from inside malloc is safe
+    thread_local bool inRealtimeSection = false;
+    thread_local bool inViolationHook = false;
+    thread_local int numAllocations = 0;
+    thread_local int numThreadViolations = 0;
+    thread_local int violationsAtSectionStart = 0;
+    thread_local RealtimeCheck::Violation firstViolation = RealtimeCheck::Violation::allocation;
+    thread_local void* firstViolationStack[maxStackFrames];
+    thread_local int numFirstViolationFrames = 0;
+
+    std::atomic<int> numViolations { 0 };
+
+    const char* getViolationName(RealtimeCheck::Violation violation)
+    {
+        switch (violation)
+        {
+            case RealtimeCheck::Violation::allocation:   return "an allocation";
+            case RealtimeCheck::Violation::deallocation: return "a deallocation";
+            case RealtimeCheck::Violation::lock:         return "a mutex lock";
+        }
+
+        return "unknown";
+    }
+
+   #if GRANULAR_DELAY_HAS_BACKTRACE
+    // The first backtrace() call loads the unwinder, which allocates, so get that out of the way early
+    const int backtraceWarmUp = []
+    {
+        void* frame[1];
+        return backtrace(frame, 1);
+    }();
+   #endif
+}
+
+//==============================================================================
+#if GRANULAR_DELAY_REALTIME_CHECKS
+
+// With the libc checks on, malloc and free below do the counting
+void* operator new(std::size_t size)
+{
+   #if ! GRANULAR_DELAY_REALTIME_CHECK_LIBC
+    RealtimeCheck::reportViolation(RealtimeCheck::Violation::allocation);
+   #endif
+
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+   #if ! GRANULAR_DELAY_REALTIME_CHECK_LIBC
+    if (ptr != nullptr)
+        RealtimeCheck::reportViolation(RealtimeCheck::Violation::deallocation);
+   #endif
+
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+#endif
+
+//==============================================================================
+#if GRANULAR_DELAY_REALTIME_CHECK_LIBC
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void __libc_free(void* ptr);
+
+    void* malloc(size_t size)
+    {
+        RealtimeCheck::reportViolation(RealtimeCheck::Violation::allocation);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        RealtimeCheck::reportViolation(RealtimeCheck::Violation::allocation);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        RealtimeCheck::reportViolation(RealtimeCheck::Violation::allocation);
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void* ptr)
+    {
+        if (ptr != nullptr)
+            RealtimeCheck::reportViolation(RealtimeCheck::Violation::deallocation);
+
+        __libc_free(ptr);
+    }
+
+    // Only blocking locks are counted, try-locks are fine on the audio thread
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        using LockFunction = int (*)(pthread_mutex_t*);
+
+        // Not a function-local static, whose guard could itself take a lock
+        static std::atomic<LockFunction> realLock { nullptr };
+        auto lock = realLock.load(std::memory_order_relaxed);
+
+        if (lock == nullptr)
+        {
+            lock = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+            realLock.store(lock, std::memory_order_relaxed);
+        }
+
+        RealtimeCheck::reportViolation(RealtimeCheck::Violation::lock);
+        return lock(mutex);
+    }
+}
+
+#endif
+
+//==============================================================================
+int RealtimeCheck::getNumAllocations()
+{
+    return numAllocations;
+}
+
+int RealtimeCheck::getNumViolations()
+{
+    return numViolations.load();
+}
+
+void RealtimeCheck::reportViolation(Violation violation)
+{
+    if (!inRealtimeSection || inViolationHook)
+        return;
+
+    inViolationHook = true;
+
+    if (violation == Violation::allocation)
+        ++numAllocations;
+
+    // Keep the stack of the first violation in the section, to report once it ends
+    if (numThreadViolations++ == violationsAtSectionStart)
+    {
+        firstViolation = violation;
+
+       #if GRANULAR_DELAY_HAS_BACKTRACE
+        numFirstViolationFrames = backtrace(firstViolationStack, maxStackFrames);
+       #endif
+    }
+
+    numViolations.fetch_add(1, std::memory_order_relaxed);
+    inViolationHook = false;
+}
+
+//==============================================================================
+RealtimeCheck::ScopedRealtimeSection::ScopedRealtimeSection()
+    : wasInRealtimeSection(inRealtimeSection), violationsAtStart(numThreadViolations)
+{
+    if (!wasInRealtimeSection)
+        violationsAtSectionStart = numThreadViolations;
+
+    inRealtimeSection = true;
+}
+
+RealtimeCheck::ScopedRealtimeSection::~ScopedRealtimeSection()
+{
+    inRealtimeSection = wasInRealtimeSection;
+
+    if (wasInRealtimeSection || numThreadViolations == violationsAtStart)
+        return;
+
+    // The section is over, so it's fine to do slow things now
+    std::fprintf(stderr, "RealtimeCheck: %d violation(s) in a realtime section, the first was %s\n",
+                 numThreadViolations - violationsAtStart, getViolationName(firstViolation));
+
+   #if GRANULAR_DELAY_HAS_BACKTRACE
+    backtrace_symbols_fd(firstViolationStack, numFirstViolationFrames, STDERR_FILENO);
+   #endif
+
+    // If this fires, something allocated, freed or locked while processing a block.
+    // The call stack of the first one has been printed to stderr.
+    jassertfalse;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// Turns the realtime checks on. They're on by default in debug builds, and the
+// tests turn them on in every build so they can fail on a violation.
+#ifndef GRANULAR_DELAY_REALTIME_CHECKS
+ #if JUCE_DEBUG
+  #define GRANULAR_DELAY_REALTIME_CHECKS 1
+ #else
+  #define GRANULAR_DELAY_REALTIME_CHECKS 0
+ #endif
+#endif
+
+// Also traps malloc, free and mutex locks by replacing the C library's versions. This only
+// works where the libc symbols can be interposed (glibc), and shouldn't be used in the
+// plugin itself since it would catch the host's calls too, so only the tests turn it on.
+#ifndef GRANULAR_DELAY_REALTIME_CHECK_LIBC
+ #define GRANULAR_DELAY_REALTIME_CHECK_LIBC 0
+#endif
+
+//==============================================================================
+// Helpers for catching heap allocations and blocking locks on the audio thread. With
+// the checks on, the global operator new and delete (and with the libc checks, malloc,
+// free and pthread_mutex_lock) count calls made while a ScopedRealtimeSection is alive
+// on the calling thread. The first offending call in a section has its stack recorded,
+// and is printed when the section ends. Without the checks the processor doesn't open
+// any sections.
+namespace RealtimeCheck
+{
+    enum class Violation
+    {
+        allocation,
+        deallocation,
+        lock
+    };
+
+    // Returns the number of allocations made on this thread inside a realtime section
+    int getNumAllocations();
+
+    // Returns the number of violations of any kind on any thread since the process started
+    int getNumViolations();
+
+    class ScopedRealtimeSection
+    {
+    public:
+        ScopedRealtimeSection();
+        ~ScopedRealtimeSection();
+
+    private:
+        bool wasInRealtimeSection;
+        int violationsAtStart;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedRealtimeSection)
+    };
+
+    // Called by the replaced allocation and locking functions
+    void reportViolation(Violation violation);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//==============================================================================
+// A multichannel ring of samples with a power-of-two capacity, so positions wrap with
+// a mask. Each channel is stored with a guard region either side of the ring that
+// mirrors the samples at the other end: the guard after the end holds a copy of the
+// start, and the guard before the start holds a copy of the end. Anything reading up
+// to guardSize samples past either end of the ring gets the right samples without
+// having to wrap, which is what lets the grain kernels read contiguously across the
+// seam. Writes keep the guards up to date.
+template <int NumChannels, typename SampleType = float>
+class RingBuffer
+{
+public:
+    static constexpr int numChannels = NumChannels;
+    static constexpr int guardSize = 512;
+
+    // Allocates room for at least minCapacity samples per channel, rounded up to a power of
+    // two, and clears it. Must not be called on the audio thread.
+    void setSize(int minCapacity)
+    {
+        capacity = 1;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+
+        // Writes mirror into the guards from a window this big at each end, so it must fit
+        capacity = std::max(capacity, 2 * guardSize);
+        mask = capacity - 1;
+        stride = static_cast<size_t>(capacity + 2 * guardSize);
+
+        samples.assign(stride * NumChannels, SampleType {});
+    }
+
+    void clear()
+    {
+        std::fill(samples.begin(), samples.end(), SampleType {});
+    }
+
+    int getCapacity() const { return capacity; }
+    int getMask() const { return mask; }
+    int wrap(int position) const { return position & mask; }
+
+    // Points at position 0 of the channel. Positions -guardSize to capacity + guardSize - 1 can be read.
+    const SampleType* getReadPointer(int channel) const
+    {
+        return samples.data() + static_cast<size_t>(channel) * stride + guardSize;
+    }
+
+    SampleType getSample(int channel, int position) const
+    {
+        return getReadPointer(channel)[wrap(position)];
+    }
+
+    // Writes numSamples (at most the capacity) into the ring starting at position, scaled
+    // by gain and wrapping around the end, then refreshes any guard samples it overwrote
+    void write(int channel, int position, const SampleType* source, int numSamples, SampleType gain = SampleType(1))
+    {
+        auto* ring = getWritePointer(channel);
+        position = wrap(position);
+
+        while (numSamples > 0)
+        {
+            int numToWrite = std::min(numSamples, capacity - position);
+
+            for (int i = 0; i < numToWrite; ++i)
+                ring[position + i] = source[i] * gain;
+
+            updateGuards(ring, position, numToWrite);
+
+            source += numToWrite;
+            numSamples -= numToWrite;
+            position = 0;
+        }
+    }
+
+    // Like write(), but sums the samples into what's already in the ring
+    void add(int channel, int position, const SampleType* source, int numSamples)
+    {
+        auto* ring = getWritePointer(channel);
+        position = wrap(position);
+
+        while (numSamples > 0)
+        {
+            int numToAdd = std::min(numSamples, capacity - position);
+
+            for (int i = 0; i < numToAdd; ++i)
+                ring[position + i] += source[i];
+
+            updateGuards(ring, position, numToAdd);
+
+            source += numToAdd;
+            numSamples -= numToAdd;
+            position = 0;
+        }
+    }
+
+    // Swaps the storage of two rings without allocating
+    void swap(RingBuffer& other) noexcept
+    {
+        samples.swap(other.samples);
+        std::swap(capacity, other.capacity);
+        std::swap(mask, other.mask);
+        std::swap(stride, other.stride);
+    }
+
+private:
+    SampleType* getWritePointer(int channel)
+    {
+        return samples.data() + static_cast<size_t>(channel) * stride + guardSize;
+    }
+
+    // Copies whatever part of [start, start + length) lies in the first or last guardSize
+    // samples of the ring into the guard at the other end
+    void updateGuards(SampleType* ring, int start, int length)
+    {
+        int end = start + length;
+
+        int headEnd = std::min(end, guardSize);
+        if (start < headEnd)
+            std::copy(ring + start, ring + headEnd, ring + capacity + start);
+
+        int tailStart = std::max(start, capacity - guardSize);
+        if (tailStart < end)
+            std::copy(ring + tailStart, ring + end, ring + tailStart - capacity);
+    }
+
+    std::vector<SampleType> samples;
+    int capacity { 0 };
+    int mask { 0 };
+    size_t stride { 0 };
+};
@@ -0,0 +1,92 @@
+#include "WaveformFeed.h"
+
+//==============================================================================
+void WaveformFeed::prepare(double sampleRate)
+{
+    historySamples = sampleRate * historySeconds;
+}
+
+void WaveformFeed::push(const juce::AudioBuffer<float>& buffer)
+{
+    auto numPeaksToShow = numPeaks.load(std::memory_order_relaxed);
+
+    if (!active.load(std::memory_order_relaxed) || numPeaksToShow <= 0)
+        return;
+
+    // Start a fresh peak if the editor changed the resolution
+    auto newSamplesPerPeak = juce::jmax(1, juce::roundToInt(historySamples / numPeaksToShow));
+
+    if (newSamplesPerPeak != currentSamplesPerPeak)
+    {
+        currentSamplesPerPeak = newSamplesPerPeak;
+        samplesInPeak = 0;
+    }
+
+    auto numSamples = buffer.getNumSamples();
+
+    for (int start = 0; start < numSamples;)
+    {
+        auto numToTake = juce::jmin(currentSamplesPerPeak - samplesInPeak, numSamples - start);
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto range = juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(channel, start), numToTake);
+
+            if (samplesInPeak == 0 && channel == 0)
+            {
+                currentPeak = { range.getStart(), range.getEnd() };
+            }
+            else
+            {
+                currentPeak.min = juce::jmin(currentPeak.min, range.getStart());
+                currentPeak.max = juce::jmax(currentPeak.max, range.getEnd());
+            }
+        }
+
+        start += numToTake;
+        samplesInPeak += numToTake;
+
+        if (samplesInPeak == currentSamplesPerPeak)
+        {
+            writePeak();
+            samplesInPeak = 0;
+        }
+    }
+}
+
+// Drops the peak if the editor has fallen behind and the FIFO is full
+void WaveformFeed::writePeak()
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        peaks[static_cast<size_t>(start1)] = currentPeak;
+    else if (size2 > 0)
+        peaks[static_cast<size_t>(start2)] = currentPeak;
+
+    fifo.finishedWrite(size1 + size2);
+}
+
+//==============================================================================
+void WaveformFeed::setActive(bool shouldBeActive)
+{
+    active.store(shouldBeActive);
+}
+
+void WaveformFeed::setNumPeaks(int newNumPeaks)
+{
+    numPeaks.store(newNumPeaks);
+}
+
+int WaveformFeed::pull(Peak* dest, int maxPeaks)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(maxPeaks, start1, size1, start2, size2);
+
+    std::copy_n(peaks.begin() + start1, size1, dest);
+    std::copy_n(peaks.begin() + start2, size2, dest + size1);
+
+    fifo.finishedRead(size1 + size2);
+    return size1 + size2;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//==============================================================================
+// Carries the input waveform from the audio thread to the editor without locks. The
+// audio thread boils each run of samplesPerPeak input samples down to a min/max peak
+// and writes it to a single-producer, single-consumer FIFO, which the editor drains
+// on its own timer. The editor picks the resolution (one peak per pixel it draws) and
+// switches the feed on while it's open, so without an editor push() returns straight away.
+class WaveformFeed
+{
+public:
+    struct Peak
+    {
+        float min = 0.f;
+        float max = 0.f;
+    };
+
+    // How much input history the editor shows, which matches the range of the range sliders
+    static constexpr double historySeconds = 5.0;
+
+    // Must not be called on the audio thread
+    void prepare(double sampleRate);
+
+    // Audio thread: adds the block to the current peak, writing out any peaks it completes
+    void push(const juce::AudioBuffer<float>& buffer);
+
+    // Editor: turns the feed on or off, and sets how many peaks span the whole history
+    void setActive(bool shouldBeActive);
+    void setNumPeaks(int numPeaks);
+
+    // Editor: reads up to maxPeaks of the oldest unread peaks into dest, and returns how many were read
+    int pull(Peak* dest, int maxPeaks);
+
+    static constexpr int fifoSize = 4096;
+
+private:
+    void writePeak();
+
+    juce::AbstractFifo fifo { fifoSize };
+    std::vector<Peak> peaks = std::vector<Peak>(static_cast<size_t>(fifoSize));
+
+    std::atomic<bool> active { false };
+    std::atomic<int> numPeaks { 0 };
+    double historySamples { 0.0 };
+
+    // Only touched by the audio thread
+    int currentSamplesPerPeak { 1 };
+    int samplesInPeak { 0 };
+    Peak currentPeak;
+};
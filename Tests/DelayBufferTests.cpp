@@ -0,0 +1,259 @@
+#include "DelayBufferTests.h"
+#include "PluginProcessor.h"
+#include "RealtimeCheck.h"
+#include "TestUtilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    constexpr double testSampleRate = 48000.0;
+    constexpr int testBlockSize = 512;
+    constexpr juce::int64 testSeed = 1234;
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+
+    // The longest range the parameters allow, and how long the delayBuffer used to be for it
+    constexpr float maxRangeEndMs = 5000.f;
+    constexpr double oldDelayBufferSeconds = 10.0;
+
+    // Long, slow, detuned grains from all over the range, fed back into the buffer, so the
+    // output depends on samples from every part of the delayBuffer
+    void setUpFarReads(GranularDelayAudioProcessor& processor)
+    {
+        TestUtilities::resetParameters(processor);
+        TestUtilities::setParameter(processor.apvts, "rangeStart", 1000.f);
+        TestUtilities::setParameter(processor.apvts, "rangeEnd", 5000.f);
+        TestUtilities::setParameter(processor.apvts, "grainSize", 80.f);
+        TestUtilities::setParameter(processor.apvts, "frequency", 60.f);
+        TestUtilities::setParameter(processor.apvts, "grainPitch", 0.5f);
+        TestUtilities::setParameter(processor.apvts, "detune", 200.f);
+        TestUtilities::setParameter(processor.apvts, "spread", 0.5f);
+        TestUtilities::setParameter(processor.apvts, "feedback", 0.5f);
+        TestUtilities::setParameter(processor.apvts, "mix", 1.f);
+    }
+
+    // Every grain starts as far back as the range goes, with the longest, slowest grains the
+    // parameters allow, so the furthest reads get as close as they can to the worst case
+    void setUpWorstCaseReads(GranularDelayAudioProcessor& processor)
+    {
+        TestUtilities::resetParameters(processor);
+        TestUtilities::setParameter(processor.apvts, "rangeStart", maxRangeEndMs);
+        TestUtilities::setParameter(processor.apvts, "rangeEnd", maxRangeEndMs);
+        TestUtilities::setParameter(processor.apvts, "grainSize", processor.apvts.getParameterRange("grainSize").end);
+        TestUtilities::setParameter(processor.apvts, "frequency", processor.apvts.getParameterRange("frequency").end);
+        TestUtilities::setParameter(processor.apvts, "grainPitch", processor.apvts.getParameterRange("grainPitch").start);
+        TestUtilities::setParameter(processor.apvts, "detune", processor.apvts.getParameterRange("detune").end);
+        TestUtilities::setParameter(processor.apvts, "mix", 1.f);
+
+        // Sinc reads the most samples either side of the read position
+        TestUtilities::setParameter(processor.apvts, "interpolation", 2.f);
+        TestUtilities::setParameter(processor.apvts, "sincRenderOnly", 0.f);
+    }
+
+    // Renders the given number of seconds of the test signal, calling beforeBlock with the
+    // block number before every block, and returns the output one channel after the other
+    template <typename BeforeBlockFunction>
+    std::vector<float> render(GranularDelayAudioProcessor& processor, double sampleRate, double seconds,
+                              BeforeBlockFunction&& beforeBlock)
+    {
+        processor.setRandomSeed(testSeed);
+        processor.setRateAndBufferSize(sampleRate, testBlockSize);
+        processor.prepareToPlay(sampleRate, testBlockSize);
+
+        auto numChannels = processor.getTotalNumOutputChannels();
+        auto numBlocks = static_cast<int>(seconds * sampleRate / testBlockSize);
+
+        juce::AudioBuffer<float> buffer(numChannels, testBlockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(5678);
+        double phase = 0;
+        std::vector<float> output(static_cast<size_t>(numChannels * numBlocks * testBlockSize));
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            beforeBlock(block);
+            TestUtilities::fillWithTestSignal(buffer, sampleRate, phase, random);
+            processor.processBlock(buffer, midi);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                std::copy_n(buffer.getReadPointer(channel), testBlockSize,
+                            output.begin() + (channel * numBlocks + block) * testBlockSize);
+        }
+
+        processor.releaseResources();
+        return output;
+    }
+
+    float getMaxDifference(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        if (a.size() != b.size())
+            return 1.f;
+
+        float maxDifference = 0.f;
+
+        for (size_t i = 0; i < a.size(); ++i)
+            maxDifference = juce::jmax(maxDifference, std::abs(a[i] - b[i]));
+
+        return maxDifference;
+    }
+
+    int getDefaultCapacity()
+    {
+        GranularDelayAudioProcessor processor;
+        processor.setRateAndBufferSize(testSampleRate, testBlockSize);
+        processor.prepareToPlay(testSampleRate, testBlockSize);
+        return processor.getDelayBufferCapacity();
+    }
+
+    //==============================================================================
+    // The ring for the longest range has to be no bigger than the fixed 10 s it used to be,
+    // and still hold the furthest read, worked out here from the parameter ranges: a grain
+    // starts at most the range end back, and the slowest one reads maxGrainSize of input
+    // over maxGrainSize / minPitch, so it ends maxGrainSize * (1 / minPitch - 1) further back
+    bool testSize(double sampleRate)
+    {
+        GranularDelayAudioProcessor processor;
+        auto size = GranularDelayAudioProcessor::getDelayBufferSize(processor.getMaxReadDistance(sampleRate, maxRangeEndMs));
+        auto oldSize = static_cast<int>(sampleRate * oldDelayBufferSeconds);
+
+        auto maxGrainSizeMs = static_cast<double>(processor.apvts.getParameterRange("grainSize").end);
+        auto minPitch = processor.apvts.getParameterRange("grainPitch").start
+                        / std::pow(2.0, processor.apvts.getParameterRange("detune").end / 1200.0);
+        auto furthestReadMs = maxRangeEndMs + maxGrainSizeMs * (1.0 / minPitch - 1.0);
+        auto furthestRead = static_cast<int>(std::ceil(furthestReadMs * sampleRate / 1000.0))
+                            + GrainKernels::SincTable::numTaps;
+
+        std::printf("  %g Hz: %d samples (was %d), furthest read %d\n", sampleRate, size, oldSize, furthestRead);
+
+        return size <= oldSize && size >= furthestRead + GranularDelayAudioProcessor::subBlockSize;
+    }
+
+    // Worst-case grains have to sound exactly the same as they do with plenty of room, which
+    // they wouldn't if the ring were too short and the write position overtook them
+    bool testWorstCaseGrains(double sampleRate)
+    {
+        // Long enough for the furthest grains to play all the way through
+        constexpr double seconds = 6.5;
+
+        GranularDelayAudioProcessor roomy;
+        setUpWorstCaseReads(roomy);
+        roomy.reserveRangeEnd(2.f * maxRangeEndMs);
+        auto expected = render(roomy, sampleRate, seconds, [] (int) {});
+
+        GranularDelayAudioProcessor processor;
+        setUpWorstCaseReads(processor);
+        auto output = render(processor, sampleRate, seconds, [] (int) {});
+
+        return juce::exactlyEqual(getMaxDifference(output, expected), 0.f);
+    }
+
+    // Before playback starts, prepareToPlay sizes the buffer for the reserved range
+    bool testReserveBeforePrepare()
+    {
+        GranularDelayAudioProcessor processor;
+        processor.reserveRangeEnd(10000.f);
+        processor.setRateAndBufferSize(testSampleRate, testBlockSize);
+        processor.prepareToPlay(testSampleRate, testBlockSize);
+
+        return processor.getDelayBufferCapacity() > getDefaultCapacity();
+    }
+
+    // Growing the buffer halfway through, after the write position has been all the way
+    // round it, must leave the output exactly as it would have been, without allocating,
+    // freeing or locking on the audio thread
+    bool testGrowWhilePlaying()
+    {
+        constexpr double seconds = 9.0;
+        constexpr int growBlock = static_cast<int>(6.0 * testSampleRate / testBlockSize);
+
+        GranularDelayAudioProcessor reference;
+        setUpFarReads(reference);
+        auto expected = render(reference, testSampleRate, seconds, [] (int) {});
+
+        GranularDelayAudioProcessor processor;
+        setUpFarReads(processor);
+
+        int capacityBefore = 0, capacityAfter = 0;
+        auto violationsAtStart = RealtimeCheck::getNumViolations();
+
+        auto output = render(processor, testSampleRate, seconds, [&] (int block)
+        {
+            if (block == growBlock)
+            {
+                capacityBefore = processor.getDelayBufferCapacity();
+                processor.reserveRangeEnd(10000.f);
+            }
+            else if (block == growBlock + 1)
+            {
+                capacityAfter = processor.getDelayBufferCapacity();
+            }
+        });
+
+        auto numViolations = RealtimeCheck::getNumViolations() - violationsAtStart;
+        auto maxDifference = getMaxDifference(output, expected);
+
+        std::printf("  capacity %d -> %d, max difference %g, %d realtime violation(s)\n",
+                    capacityBefore, capacityAfter, static_cast<double>(maxDifference), numViolations);
+
+        return capacityAfter > capacityBefore && juce::exactlyEqual(maxDifference, 0.f) && numViolations == 0;
+    }
+
+    // Asking for less than the buffer already holds leaves it alone
+    bool testReserveSmallerRange()
+    {
+        GranularDelayAudioProcessor processor;
+        int capacityBefore = 0, capacityAfter = 0;
+
+        render(processor, testSampleRate, 0.1, [&] (int block)
+        {
+            if (block == 1)
+            {
+                capacityBefore = processor.getDelayBufferCapacity();
+                processor.reserveRangeEnd(100.f);
+            }
+            else if (block == 2)
+            {
+                capacityAfter = processor.getDelayBufferCapacity();
+            }
+        });
+
+        return capacityBefore > 0 && capacityAfter == capacityBefore;
+    }
+}
+
+//==============================================================================
+int DelayBufferTests::run()
+{
+    const std::pair<const char*, bool (*)()> tests[] =
+    {
+        { "reserve before prepare", testReserveBeforePrepare },
+        { "grow while playing", testGrowWhilePlaying },
+        { "reserve a smaller range", testReserveSmallerRange }
+    };
+
+    int numFailures = 0;
+    std::printf("case,result\n");
+
+    auto report = [&numFailures] (const juce::String& name, bool passed)
+    {
+        numFailures += passed ? 0 : 1;
+
+        std::printf("%s,%s\n", name.toRawUTF8(), passed ? "pass" : "FAIL");
+        std::fflush(stdout);
+    };
+
+    for (auto sampleRate : sampleRates)
+    {
+        report("size at " + juce::String(sampleRate) + " Hz", testSize(sampleRate));
+        report("worst-case grains at " + juce::String(sampleRate) + " Hz", testWorstCaseGrains(sampleRate));
+    }
+
+    for (auto& [name, test] : tests)
+        report(name, test());
+
+    return numFailures;
+}
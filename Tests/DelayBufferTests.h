@@ -0,0 +1,14 @@
+#pragma once
+
+//==============================================================================
+// Checks how the processor sizes its delayBuffer: no bigger than the fixed 10 s it used to
+// be, yet big enough for the furthest grain at every common sample rate. Also checks that
+// reserveRangeEnd() can grow it while playing without changing a sample of the output or
+// breaking the realtime rules.
+// Every render here uses grains that read from far back in the buffer, so anything lost
+// or moved in the buffer would show up in the output.
+namespace DelayBufferTests
+{
+    // Prints one CSV row per case, and returns how many failed
+    int run();
+}
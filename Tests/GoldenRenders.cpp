@@ -0,0 +1,183 @@
+#include "GoldenRenders.h"
+#include "PluginProcessor.h"
+#include "TestUtilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    constexpr double goldenSampleRate = 48000.0;
+    constexpr double goldenSeconds = 2.0;
+    constexpr juce::int64 goldenSeed = 1234;
+    const int goldenBlockSizes[] = { 1, 7, 64, 512, 4096 };
+
+    enum class GoldenInput
+    {
+        impulses,
+        sine
+    };
+
+    // Impulses every 100 ms show exactly where each grain reads from, and the sine shows
+    // the pitch and the envelopes. Both channels get the same signal at different levels.
+    void fillWithGoldenInput(juce::AudioBuffer<float>& buffer, GoldenInput input, juce::int64 firstSample)
+    {
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        {
+            auto sampleIndex = firstSample + i;
+            float sample = 0.f;
+
+            if (input == GoldenInput::impulses)
+                sample = sampleIndex % static_cast<juce::int64>(goldenSampleRate / 10) == 0 ? 1.f : 0.f;
+            else
+                sample = 0.5f * static_cast<float>(std::sin(juce::MathConstants<double>::twoPi * 220.0
+                                                            * static_cast<double>(sampleIndex) / goldenSampleRate));
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                buffer.setSample(channel, i, sample * (channel == 0 ? 1.f : 0.5f));
+        }
+    }
+
+    // Renders goldenSeconds of the input, one channel after the other
+    std::vector<float> renderGolden(GranularDelayAudioProcessor& processor, GoldenInput input, int blockSize)
+    {
+        processor.setRandomSeed(goldenSeed);
+        processor.setRateAndBufferSize(goldenSampleRate, blockSize);
+        processor.prepareToPlay(goldenSampleRate, blockSize);
+
+        auto numChannels = processor.getTotalNumOutputChannels();
+        auto numSamples = static_cast<int>(goldenSeconds * goldenSampleRate);
+
+        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<float> output(static_cast<size_t>(numChannels * numSamples));
+
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            auto numInBlock = juce::jmin(blockSize, numSamples - start);
+            buffer.setSize(numChannels, numInBlock, false, false, true);
+
+            fillWithGoldenInput(buffer, input, start);
+            processor.processBlock(buffer, midi);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                std::copy_n(buffer.getReadPointer(channel), numInBlock,
+                            output.begin() + channel * numSamples + start);
+        }
+
+        processor.releaseResources();
+        return output;
+    }
+
+    float getMaxDifference(const float* a, const float* b, size_t numSamples)
+    {
+        float maxDifference = 0.f;
+
+        for (size_t i = 0; i < numSamples; ++i)
+            maxDifference = juce::jmax(maxDifference, std::abs(a[i] - b[i]));
+
+        return maxDifference;
+    }
+}
+
+//==============================================================================
+int GoldenRenders::run(GranularDelayAudioProcessor& processor, const juce::File& directory, Mode mode)
+{
+    if (mode == Mode::update)
+        directory.createDirectory();
+
+    // Fixed settings that exercise the random start positions and pitches. At 41.3 Hz the
+    // onsets fall well between samples, so rounding can't move one by a sample between
+    // block sizes the way it could if they landed exactly on one.
+    TestUtilities::resetParameters(processor);
+    TestUtilities::setParameter(processor.apvts, "grainSize", 30.f);
+    TestUtilities::setParameter(processor.apvts, "frequency", 41.3f);
+    TestUtilities::setParameter(processor.apvts, "rangeStart", 50.f);
+    TestUtilities::setParameter(processor.apvts, "rangeEnd", 400.f);
+    TestUtilities::setParameter(processor.apvts, "detune", 200.f);
+
+    const std::pair<const char*, juce::AudioChannelSet> layouts[] =
+    {
+        { "mono", juce::AudioChannelSet::mono() },
+        { "stereo", juce::AudioChannelSet::stereo() }
+    };
+
+    const std::pair<const char*, GoldenInput> inputs[] =
+    {
+        { "impulses", GoldenInput::impulses },
+        { "sine", GoldenInput::sine }
+    };
+
+    int numFailures = 0;
+    std::printf("input,layout,blockSize,maxDifference,maxDifferenceFromBlockSize1,result\n");
+
+    for (auto& [layoutName, channelSet] : layouts)
+    {
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(channelSet);
+        layout.outputBuses.add(channelSet);
+
+        // Every layout isBusesLayoutSupported accepts has to be covered
+        if (!processor.checkBusesLayoutSupported(layout) || !processor.setBusesLayout(layout))
+        {
+            ++numFailures;
+            std::printf(",%s,,,,FAIL (layout not supported)\n", layoutName);
+            continue;
+        }
+
+        for (auto& [inputName, input] : inputs)
+        {
+            // The engine splits whatever the host sends into sub-blocks and starts grains on
+            // exact samples, so every block size has to sound the same as a sample at a time
+            std::vector<float> firstOutput;
+
+            for (auto blockSize : goldenBlockSizes)
+            {
+                auto file = directory.getChildFile(juce::String(inputName) + "_" + layoutName + "_"
+                                                   + juce::String(blockSize) + ".raw");
+
+                auto output = renderGolden(processor, input, blockSize);
+
+                if (firstOutput.empty())
+                    firstOutput = output;
+
+                auto blockSizeDifference = getMaxDifference(output.data(), firstOutput.data(), output.size());
+                bool passed = blockSizeDifference <= goldenTolerance;
+
+                if (mode == Mode::update)
+                {
+                    bool written = file.replaceWithData(output.data(), output.size() * sizeof(float));
+                    passed = passed && written;
+
+                    numFailures += passed ? 0 : 1;
+                    std::printf("%s,%s,%d,,%g,%s\n", inputName, layoutName, blockSize,
+                                static_cast<double>(blockSizeDifference), passed ? "written" : "FAIL");
+                    continue;
+                }
+
+                // A missing reference is a failure: it has to be written with --golden-update
+                // from a build you trust and committed, never made up by the check itself
+                juce::MemoryBlock reference;
+                bool found = file.loadFileAsData(reference) && reference.getSize() == output.size() * sizeof(float);
+                float maxDifference = 0.f;
+
+                if (found)
+                    maxDifference = getMaxDifference(output.data(), static_cast<const float*>(reference.getData()),
+                                                     output.size());
+
+                passed = passed && found && maxDifference <= goldenTolerance;
+                numFailures += passed ? 0 : 1;
+
+                std::printf("%s,%s,%d,%s,%g,%s\n", inputName, layoutName, blockSize,
+                            found ? juce::String(maxDifference).toRawUTF8() : "missing",
+                            static_cast<double>(blockSizeDifference), passed ? "pass" : "FAIL");
+                std::fflush(stdout);
+            }
+        }
+    }
+
+    return numFailures;
+}
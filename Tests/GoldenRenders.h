@@ -0,0 +1,27 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+class GranularDelayAudioProcessor;
+
+//==============================================================================
+// Checks that the processor still sounds the same. Fixed impulse and sine inputs are
+// rendered with a fixed random seed and fixed settings, in mono and stereo and at block
+// sizes from 1 to 4096, and each render is compared against a reference stored as raw
+// floats in a directory. A render fails if its reference is missing, or if any sample is
+// off by more than goldenTolerance from the reference or from the render at block size 1.
+namespace GoldenRenders
+{
+    // Leaves room for compilers and instruction sets to round differently, while still
+    // catching a grain that starts a sample late or plays at the wrong gain
+    constexpr float goldenTolerance = 1.0e-4f;
+
+    enum class Mode
+    {
+        check, // Compare every render against its reference
+        update // Write every reference, for when the sound is meant to change
+    };
+
+    // Prints one CSV row per render, and returns how many failed
+    int run(GranularDelayAudioProcessor& processor, const juce::File& directory, Mode mode);
+}
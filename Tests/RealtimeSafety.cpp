@@ -0,0 +1,159 @@
+#include "RealtimeSafety.h"
+#include "PluginProcessor.h"
+#include "RealtimeCheck.h"
+#include "TestUtilities.h"
+
+#include <cstdio>
+#include <vector>
+
+#if !GRANULAR_DELAY_REALTIME_CHECKS
+ #error "The realtime safety test needs GRANULAR_DELAY_REALTIME_CHECKS turned on"
+#endif
+
+namespace
+{
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    const int blockSizes[] = { 64, 256, 1024 };
+
+    // Reports a tempo and nothing else, like a host that isn't playing
+    struct FixedTempoPlayHead : juce::AudioPlayHead
+    {
+        explicit FixedTempoPlayHead(double tempo) : bpm(tempo) {}
+
+        juce::Optional<PositionInfo> getPosition() const override
+        {
+            PositionInfo position;
+            position.setBpm(bpm);
+            return position;
+        }
+
+        double bpm;
+    };
+
+    // Runs the processor with the parameters set by setUpBlock before every block,
+    // and returns how many realtime violations processBlock caused
+    template <typename SetUpFunction>
+    int countViolations(GranularDelayAudioProcessor& processor, double sampleRate, int blockSize,
+                        double seconds, SetUpFunction&& setUpBlock)
+    {
+        processor.setRateAndBufferSize(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer(processor.getTotalNumOutputChannels(), blockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(1234);
+        double phase = 0;
+
+        std::vector<WaveformFeed::Peak> peaks(static_cast<size_t>(WaveformFeed::fifoSize));
+        std::vector<GrainTelemetry::Event> events(static_cast<size_t>(GrainTelemetry::fifoSize));
+
+        auto numBlocks = static_cast<int>(seconds * sampleRate / blockSize);
+        auto violationsAtStart = RealtimeCheck::getNumViolations();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            setUpBlock(block);
+            TestUtilities::fillWithTestSignal(buffer, sampleRate, phase, random);
+            processor.processBlock(buffer, midi);
+
+            // Drain the feeds like the editor's timers would, so they never fill up and stop writing
+            processor.getWaveformFeed().pull(peaks.data(), WaveformFeed::fifoSize);
+            processor.getGrainTelemetry().pull(events.data(), GrainTelemetry::fifoSize);
+        }
+
+        processor.releaseResources();
+
+        return RealtimeCheck::getNumViolations() - violationsAtStart;
+    }
+}
+
+//==============================================================================
+int RealtimeSafety::run(GranularDelayAudioProcessor& processor, double secondsPerCase)
+{
+    int totalViolations = 0;
+
+    auto check = [&] (double sampleRate, int blockSize, const juce::String& name, auto&& setUpBlock)
+    {
+        auto numViolations = countViolations(processor, sampleRate, blockSize, secondsPerCase, setUpBlock);
+        totalViolations += numViolations;
+
+        std::printf("%g,%d,%s,%d\n", sampleRate, blockSize, name.toRawUTF8(), numViolations);
+        std::fflush(stdout);
+    };
+
+    // Stand in for an open editor, so every block writes the waveform and grain feeds too
+    processor.getWaveformFeed().setNumPeaks(1000);
+    processor.getWaveformFeed().setActive(true);
+    processor.getGrainTelemetry().setActive(true);
+
+    // Tempo-synced 1/32 notes at 1200 bpm start 160 grains a second, and at a quarter of the
+    // speed each 100 ms grain plays for 400 ms, so some 64 play at once: enough for the
+    // grainWorkerPool to take them
+    FixedTempoPlayHead fastPlayHead(1200.0);
+    constexpr double denseSeconds = 1.0;
+
+    std::printf("sampleRate,blockSize,case,violations\n");
+
+    for (auto sampleRate : sampleRates)
+    {
+        for (auto blockSize : blockSizes)
+        {
+            TestUtilities::resetParameters(processor);
+            check(sampleRate, blockSize, "defaults", [] (int) {});
+
+            for (auto* parameter : processor.getParameters())
+            {
+                for (auto extreme : { 0.f, 1.f })
+                {
+                    TestUtilities::resetParameters(processor);
+                    parameter->setValueNotifyingHost(extreme);
+
+                    auto name = parameter->getName(64) + (juce::exactlyEqual(extreme, 0.f) ? " min" : " max");
+                    check(sampleRate, blockSize, name, [] (int) {});
+                }
+            }
+
+            check(sampleRate, blockSize, "all min", [&] (int) { TestUtilities::setAllParameters(processor, 0.f); });
+            check(sampleRate, blockSize, "all max", [&] (int) { TestUtilities::setAllParameters(processor, 1.f); });
+
+            // Jumping every parameter between its extremes keeps the smoothers busy
+            check(sampleRate, blockSize, "all jumping", [&] (int block)
+            {
+                TestUtilities::setAllParameters(processor, static_cast<float>(block % 2));
+            });
+
+            TestUtilities::resetParameters(processor);
+            TestUtilities::setParameter(processor.apvts, "multithreaded", 1.f);
+            TestUtilities::setParameter(processor.apvts, "grainTiming", 1.f); // Tempo Sync
+            TestUtilities::setParameter(processor.apvts, "syncRate", 5.f);    // 1/32
+            TestUtilities::setParameter(processor.apvts, "grainSize", 100.f);
+            TestUtilities::setParameter(processor.apvts, "grainPitch", 0.25f);
+            processor.setPlayHead(&fastPlayHead);
+
+            int peakNumGrains = 0;
+            auto numViolations = countViolations(processor, sampleRate, blockSize,
+                                                 juce::jmax(secondsPerCase, denseSeconds), [&] (int)
+            {
+                peakNumGrains = juce::jmax(peakNumGrains, processor.getNumLiveGrains());
+            });
+
+            processor.setPlayHead(nullptr);
+
+            // A cloud too sparse for the workers would leave them untested, so that counts too
+            if (peakNumGrains <= GrainWorkerPool::minGrainsForWorkers)
+            {
+                std::fprintf(stderr, "The multithreaded case only reached %d grains\n", peakNumGrains);
+                ++numViolations;
+            }
+
+            totalViolations += numViolations;
+            std::printf("%g,%d,multithreaded %d grains,%d\n", sampleRate, blockSize, peakNumGrains, numViolations);
+            std::fflush(stdout);
+        }
+    }
+
+    processor.getWaveformFeed().setActive(false);
+    processor.getGrainTelemetry().setActive(false);
+
+    return totalViolations;
+}
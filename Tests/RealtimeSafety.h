@@ -0,0 +1,16 @@
+#pragma once
+
+class GranularDelayAudioProcessor;
+
+//==============================================================================
+// Drives every parameter to its extremes (and jumps between them every block) at several
+// sample rates and block sizes, counting anything inside processBlock that allocates, frees
+// or takes a lock (see RealtimeCheck). The waveform and grain feeds are switched on as if the
+// editor were open, and one case per block size plays a cloud dense enough for the
+// multithreaded grain workers. The call stack of the first offender in a block is printed
+// to stderr.
+namespace RealtimeSafety
+{
+    // Prints one CSV row per case, and returns the number of violations
+    int run(GranularDelayAudioProcessor& processor, double secondsPerCase);
+}
@@ -0,0 +1,278 @@
+#include "RingBufferTests.h"
+#include "RingBuffer.h"
+
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    using TestRing = RingBuffer<2>;
+    constexpr int guardSize = TestRing::guardSize;
+
+    // The samples are whole numbers well inside float precision, so they have to match exactly
+    bool exactlyEqual(float a, float b) { return std::equal_to<float>()(a, b); }
+
+    // What the ring should hold: one plain array per channel, with every position wrapped by hand
+    struct ReferenceRing
+    {
+        explicit ReferenceRing(int ringCapacity)
+            : capacity(ringCapacity),
+              samples(TestRing::numChannels, std::vector<float>(static_cast<size_t>(ringCapacity)))
+        {
+        }
+
+        float& at(int channel, int position)
+        {
+            position %= capacity;
+            return samples[static_cast<size_t>(channel)][static_cast<size_t>(position < 0 ? position + capacity : position)];
+        }
+
+        void write(int channel, int position, const float* source, int numSamples, float gain = 1.f)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                at(channel, position + i) = source[i] * gain;
+        }
+
+        void add(int channel, int position, const float* source, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                at(channel, position + i) += source[i];
+        }
+
+        int capacity;
+        std::vector<std::vector<float>> samples;
+    };
+
+    std::vector<float> makeRamp(int numSamples, float first)
+    {
+        std::vector<float> ramp(static_cast<size_t>(numSamples));
+
+        for (int i = 0; i < numSamples; ++i)
+            ramp[static_cast<size_t>(i)] = first + static_cast<float>(i);
+
+        return ramp;
+    }
+
+    // Reads every position the kernels may touch, guards included, straight from the read
+    // pointer without wrapping, and compares it with the reference
+    bool matches(const TestRing& ring, ReferenceRing& reference)
+    {
+        for (int channel = 0; channel < TestRing::numChannels; ++channel)
+        {
+            auto* samples = ring.getReadPointer(channel);
+
+            for (int position = -guardSize; position < ring.getCapacity() + guardSize; ++position)
+            {
+                if (!exactlyEqual(samples[position], reference.at(channel, position)))
+                {
+                    std::printf("  channel %d position %d: read %g, expected %g\n", channel, position,
+                                static_cast<double>(samples[position]),
+                                static_cast<double>(reference.at(channel, position)));
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool isSilent(const TestRing& ring)
+    {
+        for (int channel = 0; channel < TestRing::numChannels; ++channel)
+            for (int position = -guardSize; position < ring.getCapacity() + guardSize; ++position)
+                if (!exactlyEqual(ring.getReadPointer(channel)[position], 0.f))
+                    return false;
+
+        return true;
+    }
+
+    //==============================================================================
+    bool testSetSize()
+    {
+        TestRing ring;
+        bool passed = true;
+
+        // Rounds up to a power of two, and never below the two guard windows
+        const int sizes[][2] = { { 1, 2 * guardSize }, { 2 * guardSize, 2 * guardSize },
+                                 { 2 * guardSize + 1, 4 * guardSize }, { 3000, 4096 }, { 65536, 65536 } };
+
+        for (auto& [minCapacity, expected] : sizes)
+        {
+            ring.setSize(minCapacity);
+            passed = passed && ring.getCapacity() == expected && ring.getMask() == expected - 1
+                     && ring.wrap(expected + 3) == 3 && ring.wrap(-1) == expected - 1;
+        }
+
+        // Resizing throws the old contents away, guards included
+        auto ramp = makeRamp(ring.getCapacity(), 1.f);
+        ring.write(0, 0, ramp.data(), ring.getCapacity());
+        ring.setSize(3000);
+
+        return passed && isSilent(ring);
+    }
+
+    bool testWriteAcrossEnd()
+    {
+        TestRing ring;
+        ring.setSize(1024);
+        ReferenceRing reference(ring.getCapacity());
+
+        // Straddles the end, so it fills the tail guard window, wraps, and fills the head one
+        auto ramp = makeRamp(300, 1.f);
+        ring.write(0, ring.getCapacity() - 100, ramp.data(), 300);
+        reference.write(0, ring.getCapacity() - 100, ramp.data(), 300);
+
+        // Positions outside the ring wrap, and the gain is applied
+        ring.write(1, 3 * ring.getCapacity() - 50, ramp.data(), 300, 0.5f);
+        reference.write(1, 3 * ring.getCapacity() - 50, ramp.data(), 300, 0.5f);
+
+        // A whole ring's worth from the middle rewrites both guards at once
+        auto full = makeRamp(ring.getCapacity(), 1000.f);
+        ring.write(1, ring.getCapacity() / 2 + 7, full.data(), ring.getCapacity());
+        reference.write(1, ring.getCapacity() / 2 + 7, full.data(), ring.getCapacity());
+
+        return matches(ring, reference);
+    }
+
+    bool testAddAcrossEnd()
+    {
+        TestRing ring;
+        ring.setSize(1024);
+        ReferenceRing reference(ring.getCapacity());
+
+        auto ramp = makeRamp(400, 1.f);
+        auto moreRamp = makeRamp(400, -200.f);
+
+        for (int channel = 0; channel < TestRing::numChannels; ++channel)
+        {
+            ring.write(channel, ring.getCapacity() - 200, ramp.data(), 400);
+            reference.write(channel, ring.getCapacity() - 200, ramp.data(), 400);
+
+            // Overlaps the write on both sides of the end, and then runs past it
+            ring.add(channel, ring.getCapacity() - 250, moreRamp.data(), 400);
+            reference.add(channel, ring.getCapacity() - 250, moreRamp.data(), 400);
+        }
+
+        return matches(ring, reference);
+    }
+
+    // Runs of every length at every kind of position, the way the delay line and the
+    // feedback path use the ring, checking the guards after each one
+    bool testRandomWritesAndAdds()
+    {
+        TestRing ring;
+        ring.setSize(2 * guardSize);
+        ReferenceRing reference(ring.getCapacity());
+
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<int> positions(-2 * ring.getCapacity(), 2 * ring.getCapacity());
+        std::uniform_int_distribution<int> lengths(0, ring.getCapacity());
+        std::uniform_int_distribution<int> values(-1000, 1000);
+
+        for (int run = 0; run < 500; ++run)
+        {
+            auto channel = run % TestRing::numChannels;
+            auto position = positions(random);
+            auto source = makeRamp(lengths(random), static_cast<float>(values(random)));
+            auto numSamples = static_cast<int>(source.size());
+
+            if (run % 3 == 0)
+            {
+                ring.add(channel, position, source.data(), numSamples);
+                reference.add(channel, position, source.data(), numSamples);
+            }
+            else
+            {
+                ring.write(channel, position, source.data(), numSamples);
+                reference.write(channel, position, source.data(), numSamples);
+            }
+
+            if (!matches(ring, reference))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool testGetSample()
+    {
+        TestRing ring;
+        ring.setSize(1024);
+        ReferenceRing reference(ring.getCapacity());
+
+        auto ramp = makeRamp(ring.getCapacity(), 1.f);
+        ring.write(0, 0, ramp.data(), ring.getCapacity());
+        reference.write(0, 0, ramp.data(), ring.getCapacity());
+
+        for (int position = -3 * ring.getCapacity(); position < 3 * ring.getCapacity(); position += 37)
+            if (!exactlyEqual(ring.getSample(0, position), reference.at(0, position)))
+                return false;
+
+        return true;
+    }
+
+    // The processor swaps a bigger ring in while playing, so both have to come out whole
+    bool testSwap()
+    {
+        TestRing small, big;
+        small.setSize(1024);
+        big.setSize(4096);
+        ReferenceRing smallReference(small.getCapacity()), bigReference(big.getCapacity());
+
+        auto ramp = makeRamp(big.getCapacity(), 1.f);
+        small.write(0, 900, ramp.data(), 300);
+        smallReference.write(0, 900, ramp.data(), 300);
+        big.write(1, 4000, ramp.data(), 200);
+        bigReference.write(1, 4000, ramp.data(), 200);
+
+        small.swap(big);
+
+        return small.getCapacity() == 4096 && small.getMask() == 4095 && big.getCapacity() == 1024
+               && matches(small, bigReference) && matches(big, smallReference);
+    }
+
+    bool testClear()
+    {
+        TestRing ring;
+        ring.setSize(1024);
+
+        auto ramp = makeRamp(ring.getCapacity(), 1.f);
+        for (int channel = 0; channel < TestRing::numChannels; ++channel)
+            ring.write(channel, 5, ramp.data(), ring.getCapacity());
+
+        ring.clear();
+        return ring.getCapacity() == 1024 && isSilent(ring);
+    }
+}
+
+//==============================================================================
+int RingBufferTests::run()
+{
+    const std::pair<const char*, bool (*)()> tests[] =
+    {
+        { "setSize", testSetSize },
+        { "write across the end", testWriteAcrossEnd },
+        { "add across the end", testAddAcrossEnd },
+        { "random writes and adds", testRandomWritesAndAdds },
+        { "getSample", testGetSample },
+        { "swap", testSwap },
+        { "clear", testClear }
+    };
+
+    int numFailures = 0;
+    std::printf("case,result\n");
+
+    for (auto& [name, test] : tests)
+    {
+        bool passed = test();
+        numFailures += passed ? 0 : 1;
+
+        std::printf("%s,%s\n", name, passed ? "pass" : "FAIL");
+        std::fflush(stdout);
+    }
+
+    return numFailures;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+//==============================================================================
+// Checks the RingBuffer the delay line is built on against a plain array that wraps every
+// position by hand: writes and adds that straddle the end of the ring, reads up to guardSize
+// past either end, setSize, swap and clear.
+namespace RingBufferTests
+{
+    // Prints one CSV row per case, and returns how many failed
+    int run();
+}
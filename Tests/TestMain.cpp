@@ -0,0 +1,118 @@
+// Runs the GranularDelay tests without a host. CTest runs each mode as its own test
+// (see CMakeLists.txt), and any of them can be run by hand the same way.
+//
+// --golden checks that the processor still sounds the same, by comparing fixed renders
+// against the references in the given directory (see GoldenRenders). --golden-update
+// rewrites every reference, for when the sound is meant to change. It is never run by CTest,
+// so commit what it writes from a build you trust.
+//
+// --realtime-check drives every parameter to its extremes and fails if anything inside
+// processBlock allocates, frees or takes a lock (see RealtimeSafety).
+//
+// --ring-buffer checks the RingBuffer the delay line is built on (see RingBufferTests), and
+// --delay-buffer checks how the processor sizes and grows it (see DelayBufferTests).
+//
+// Usage: GranularDelayTests --golden | --golden-update <reference directory>
+//        GranularDelayTests --realtime-check [seconds of audio per case]
+//        GranularDelayTests --ring-buffer | --delay-buffer
+
+#include "DelayBufferTests.h"
+#include "GoldenRenders.h"
+#include "PluginProcessor.h"
+#include "RealtimeSafety.h"
+#include "RingBufferTests.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    void printUsage()
+    {
+        std::fprintf(stderr, "Usage: GranularDelayTests --golden | --golden-update <reference directory>\n"
+                             "       GranularDelayTests --realtime-check [seconds of audio per case]\n"
+                             "       GranularDelayTests --ring-buffer | --delay-buffer\n");
+    }
+
+    int runGolden(const juce::String& mode, const char* directoryArgument)
+    {
+        auto goldenMode = mode == "--golden-update" ? GoldenRenders::Mode::update : GoldenRenders::Mode::check;
+
+        GranularDelayAudioProcessor processor;
+        auto directory = juce::File::getCurrentWorkingDirectory().getChildFile(directoryArgument);
+        auto numFailures = GoldenRenders::run(processor, directory, goldenMode);
+
+        if (numFailures > 0)
+        {
+            std::fprintf(stderr, "%d golden render(s) failed against the references in %s\n", numFailures,
+                         directory.getFullPathName().toRawUTF8());
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int runRealtimeCheck(double secondsPerCase)
+    {
+        GranularDelayAudioProcessor processor;
+        auto numViolations = RealtimeSafety::run(processor, secondsPerCase);
+
+        if (numViolations > 0)
+        {
+            std::fprintf(stderr, "%d realtime violation(s) in processBlock\n", numViolations);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int runRingBufferTests()
+    {
+        auto numFailures = RingBufferTests::run();
+
+        if (numFailures > 0)
+        {
+            std::fprintf(stderr, "%d ring buffer test(s) failed\n", numFailures);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int runDelayBufferTests()
+    {
+        auto numFailures = DelayBufferTests::run();
+
+        if (numFailures > 0)
+        {
+            std::fprintf(stderr, "%d delay buffer test(s) failed\n", numFailures);
+            return 1;
+        }
+
+        return 0;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The parameter state uses timers and async updates, which need the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::String mode = argc > 1 ? juce::String(argv[1]) : juce::String();
+
+    if ((mode == "--golden" || mode == "--golden-update") && argc == 3)
+        return runGolden(mode, argv[2]);
+
+    if (mode == "--realtime-check" && argc <= 3)
+        return runRealtimeCheck(argc == 3 ? juce::jmax(0.1, std::atof(argv[2])) : 0.5);
+
+    if (mode == "--ring-buffer" && argc == 2)
+        return runRingBufferTests();
+
+    if (mode == "--delay-buffer" && argc == 2)
+        return runDelayBufferTests();
+
+    printUsage();
+    return 1;
+}
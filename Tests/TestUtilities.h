@@ -0,0 +1,46 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <cmath>
+
+//==============================================================================
+// Helpers shared by the tests and the processor benchmark for driving the processor
+// without a host
+namespace TestUtilities
+{
+    inline void setParameter(juce::AudioProcessorValueTreeState& apvts, const juce::String& parameterID, float value)
+    {
+        auto* parameter = apvts.getParameter(parameterID);
+        jassert(parameter != nullptr);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    inline void resetParameters(juce::AudioProcessor& processor)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost(parameter->getDefaultValue());
+    }
+
+    inline void setAllParameters(juce::AudioProcessor& processor, float normalisedValue)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost(normalisedValue);
+    }
+
+    // Fills the block with a quiet sine plus noise, so the grains always have something to read
+    inline void fillWithTestSignal(juce::AudioBuffer<float>& buffer, double sampleRate, double& phase,
+                                   juce::Random& random)
+    {
+        auto phaseIncrement = juce::MathConstants<double>::twoPi * 220.0 / sampleRate;
+
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        {
+            auto sine = 0.25f * static_cast<float>(std::sin(phase));
+            phase = std::fmod(phase + phaseIncrement, juce::MathConstants<double>::twoPi);
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                buffer.setSample(channel, i, sine + 0.05f * (random.nextFloat() * 2.f - 1.f));
+        }
+    }
+}
@@ -0,0 +1,325 @@
+// Renders audio files through GranularDelayAudioProcessor without a host, for batch
+// pipelines. Each worker thread owns one processor and takes the next file from the
+// list until none are left. Files are streamed through processBlock a block at a time,
+// so they're never loaded whole, and a worker only prepares its processor again when
+// the sample rate or channel count changes: between files it just resets it.
+//
+// The settings come from a preset file holding the plugin state as XML, including the
+// random seed, so a batch comes out the same every time it's run. --write-preset writes
+// the default settings with a fresh seed, as a starting point.
+//
+// Every output is written to the output directory with the input's name and format.
+// Mono and stereo files are supported.
+//
+// Usage: BatchRender --preset <file> --output <directory> [--threads <n>] [--block-size <n>]
+//                    [--tail] <input files...>
+//        BatchRender --write-preset <file>
+
+#include "PluginProcessor.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        juce::File preset;
+        juce::File outputDirectory;
+        juce::Array<juce::File> inputs;
+        int numThreads = static_cast<int>(juce::jmax(1u, std::thread::hardware_concurrency()));
+        int blockSize = 512;
+        bool renderTail = false;
+    };
+
+    struct FileResult
+    {
+        bool succeeded = false;
+        juce::String error;
+        double audioSeconds = 0;
+        double renderSeconds = 0;
+    };
+
+    void printUsage()
+    {
+        std::fprintf(stderr, "Usage: BatchRender --preset <file> --output <directory> [--threads <n>] "
+                             "[--block-size <n>] [--tail] <input files...>\n"
+                             "       BatchRender --write-preset <file>\n");
+    }
+
+    bool loadPreset(GranularDelayAudioProcessor& processor, const juce::File& presetFile)
+    {
+        auto xml = juce::parseXML(presetFile);
+
+        if (xml == nullptr || !xml->hasTagName(processor.apvts.state.getType()))
+            return false;
+
+        // setStateInformation reads the stream format that getStateInformation writes
+        juce::MemoryOutputStream stream;
+        juce::ValueTree::fromXml(*xml).writeToStream(stream);
+        processor.setStateInformation(stream.getData(), static_cast<int>(stream.getDataSize()));
+
+        // Files are already spread across threads, so the grain workers would only compete with
+        // them. The processor only starts its worker pool in prepareToPlay, or when this
+        // parameter turns on after that, so turning it off first means no processor ever starts one.
+        if (auto* multithreaded = processor.apvts.getParameter("multithreaded"))
+            multithreaded->setValueNotifyingHost(0.f);
+
+        processor.setNonRealtime(true);
+        return true;
+    }
+
+    //==============================================================================
+    // Renders files with one processor, preparing it again only when the format changes
+    class Worker
+    {
+    public:
+        Worker(GranularDelayAudioProcessor& processorToUse, const Options& optionsToUse)
+            : processor(processorToUse), options(optionsToUse)
+        {
+            formatManager.registerBasicFormats();
+        }
+
+        FileResult render(const juce::File& input)
+        {
+            FileResult result;
+            std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(input));
+
+            if (reader == nullptr)
+            {
+                result.error = "can't read the file";
+                return result;
+            }
+
+            auto numChannels = static_cast<int>(reader->numChannels);
+
+            if (numChannels < 1 || numChannels > 2)
+            {
+                result.error = "only mono and stereo files are supported";
+                return result;
+            }
+
+            auto* format = formatManager.findFormatForFileExtension(input.getFileExtension());
+
+            if (format == nullptr)
+            {
+                result.error = "can't write files like this one";
+                return result;
+            }
+
+            auto output = options.outputDirectory.getChildFile(input.getFileName());
+
+            if (output == input)
+            {
+                result.error = "the output would overwrite the input";
+                return result;
+            }
+
+            output.deleteFile();
+            auto stream = std::make_unique<juce::FileOutputStream>(output);
+
+            // FLAC tops out at 24 bits, and WAV writes 32 bits as float
+            auto bitsPerSample = static_cast<int>(reader->bitsPerSample);
+            if (!format->getPossibleBitDepths().contains(bitsPerSample))
+                bitsPerSample = format->getPossibleBitDepths().getLast();
+
+            std::unique_ptr<juce::AudioFormatWriter> writer(
+                format->createWriterFor(stream.get(), reader->sampleRate, static_cast<unsigned int>(numChannels),
+                                        bitsPerSample, reader->metadataValues, 0));
+
+            if (writer == nullptr)
+            {
+                result.error = "can't write " + output.getFullPathName();
+                return result;
+            }
+
+            stream.release(); // The writer owns the stream now
+
+            auto start = std::chrono::steady_clock::now();
+
+            prepare(reader->sampleRate, numChannels);
+
+            buffer.setSize(numChannels, options.blockSize, false, false, true);
+            juce::MidiBuffer midi;
+
+            auto inputLength = reader->lengthInSamples;
+            auto tailLength = options.renderTail
+                                ? static_cast<juce::int64>(std::ceil(processor.getTailLengthSeconds() * reader->sampleRate))
+                                : 0;
+
+            for (juce::int64 position = 0; position < inputLength + tailLength; position += options.blockSize)
+            {
+                auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(options.blockSize),
+                                                              inputLength + tailLength - position));
+                buffer.setSize(numChannels, numSamples, false, false, true);
+
+                // Past the end of the input, the reader fills the buffer with silence
+                reader->read(&buffer, 0, numSamples, position, true, true);
+                processor.processBlock(buffer, midi);
+
+                if (!writer->writeFromAudioSampleBuffer(buffer, 0, numSamples))
+                {
+                    result.error = "failed writing " + output.getFullPathName();
+                    return result;
+                }
+            }
+
+            result.succeeded = true;
+            result.audioSeconds = static_cast<double>(inputLength + tailLength) / reader->sampleRate;
+            result.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+    private:
+        void prepare(double sampleRate, int numChannels)
+        {
+            if (juce::exactlyEqual(sampleRate, preparedSampleRate) && numChannels == preparedNumChannels)
+            {
+                processor.reset();
+                return;
+            }
+
+            auto channelSet = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(channelSet);
+            layout.outputBuses.add(channelSet);
+
+            processor.releaseResources();
+            processor.setBusesLayout(layout);
+            processor.setRateAndBufferSize(sampleRate, options.blockSize);
+            processor.prepareToPlay(sampleRate, options.blockSize);
+
+            preparedSampleRate = sampleRate;
+            preparedNumChannels = numChannels;
+        }
+
+        GranularDelayAudioProcessor& processor;
+        const Options& options;
+        juce::AudioFormatManager formatManager;
+        juce::AudioBuffer<float> buffer;
+        double preparedSampleRate = 0;
+        int preparedNumChannels = 0;
+    };
+
+    //==============================================================================
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            juce::String argument(argv[i]);
+            bool hasValue = i + 1 < argc;
+
+            if (argument == "--preset" && hasValue)
+                options.preset = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+            else if (argument == "--output" && hasValue)
+                options.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+            else if (argument == "--threads" && hasValue)
+                options.numThreads = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+            else if (argument == "--block-size" && hasValue)
+                options.blockSize = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+            else if (argument == "--tail")
+                options.renderTail = true;
+            else if (argument.startsWith("--"))
+                return false;
+            else
+                options.inputs.add(juce::File::getCurrentWorkingDirectory().getChildFile(argument));
+        }
+
+        return options.preset != juce::File() && options.outputDirectory != juce::File() && !options.inputs.isEmpty();
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    // The parameter state uses timers and async updates, which need the message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    if (argc == 3 && juce::String(argv[1]) == "--write-preset")
+    {
+        GranularDelayAudioProcessor processor;
+        auto xml = processor.apvts.copyState().createXml();
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile(argv[2]);
+        return xml != nullptr && xml->writeTo(file) ? 0 : 1;
+    }
+
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (!options.outputDirectory.createDirectory())
+    {
+        std::fprintf(stderr, "Can't create %s\n", options.outputDirectory.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    // The processors are made here on the main thread, which their parameter state expects
+    auto numWorkers = juce::jmin(options.numThreads, options.inputs.size());
+    std::vector<std::unique_ptr<GranularDelayAudioProcessor>> processors;
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        processors.push_back(std::make_unique<GranularDelayAudioProcessor>());
+
+        if (!loadPreset(*processors.back(), options.preset))
+        {
+            std::fprintf(stderr, "Can't load the preset %s\n", options.preset.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+
+    std::vector<FileResult> results(static_cast<size_t>(options.inputs.size()));
+    std::atomic<int> nextFile { 0 };
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+
+    for (auto& processor : processors)
+    {
+        threads.emplace_back([&, processorToUse = processor.get()]
+        {
+            Worker worker(*processorToUse, options);
+
+            for (int file = nextFile++; file < options.inputs.size(); file = nextFile++)
+                results[static_cast<size_t>(file)] = worker.render(options.inputs[file]);
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // One CSV row per file, then the throughput of the whole batch
+    int numFailures = 0;
+    double totalAudioSeconds = 0;
+
+    std::printf("file,audioSeconds,renderSeconds,realtimeMultiple,error\n");
+
+    for (int i = 0; i < options.inputs.size(); ++i)
+    {
+        auto& result = results[static_cast<size_t>(i)];
+        numFailures += result.succeeded ? 0 : 1;
+        totalAudioSeconds += result.audioSeconds;
+
+        std::printf("%s,%.3f,%.3f,%.1f,%s\n", options.inputs[i].getFullPathName().toRawUTF8(),
+                    result.audioSeconds, result.renderSeconds,
+                    result.renderSeconds > 0 ? result.audioSeconds / result.renderSeconds : 0.0,
+                    result.error.toRawUTF8());
+    }
+
+    std::fprintf(stderr, "Rendered %d of %d file(s), %.1f s of audio in %.1f s on %d thread(s): %.1fx realtime\n",
+                 options.inputs.size() - numFailures, options.inputs.size(), totalAudioSeconds, elapsed.count(),
+                 numWorkers, elapsed.count() > 0 ? totalAudioSeconds / elapsed.count() : 0.0);
+
+    return numFailures > 0 ? 1 : 0;
+}